@@ -0,0 +1,140 @@
+/**
+ * @file checksum.h
+ * @brief Function prototypes for the checksums that protect segments
+ *
+ * This header file contains the function prototypes for the 16 bit one's
+ * complement sum of RFC 1071, accumulated a word or a vector at a time, and
+ * for CRC32C, computed with the SSE4.2 instruction where the CPU has it. The
+ * vector and SSE4.2 variants are picked at run time.
+ *
+ * @author Ritam Singal (ritamsingal)
+ * @author Harshil Patel (harshil-patel11)
+ * @bug No known bugs
+ */
+
+#ifndef CHECKSUM_H
+#define CHECKSUM_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * @brief Enum representing the checksum a segment is protected with
+ */
+typedef enum checksum_type {
+  CHECKSUM_INTERNET = 0, // 16 bit one's complement sum, as in UDP and TCP
+  CHECKSUM_CRC32C = 1    // CRC32C, as in SCTP and iSCSI
+} checksum_type_t;
+
+/**
+ * @brief Parse the name of a checksum
+ *
+ * @param name "internet" or "crc32c"
+ * @param type Pointer where the checksum type is stored
+ * @return int 0 if successful, -1 if the name is unknown
+ */
+int parse_checksum_type(const char *name, checksum_type_t *type);
+
+/**
+ * @brief Compute the checksum of a segment
+ *
+ * The checksum covers the encoded header, whose checksum field has to be
+ * zero, followed by the payload. header_len has to be a multiple of 4.
+ *
+ * @param type The checksum to compute
+ * @param header The encoded header
+ * @param header_len Bytes of the header
+ * @param payload The payload
+ * @param payload_len Bytes of the payload
+ * @return uint32_t the CRC32C, or the one's complement sum in the low 16 bits
+ */
+uint32_t compute_checksum(checksum_type_t type, const void *header,
+                          size_t header_len, const void *payload,
+                          size_t payload_len);
+
+/**
+ * @brief Add bytes to a one's complement sum
+ *
+ * The bytes are added as 16 bit words in memory order, with a zero byte
+ * appended if their number is odd, so a sum can be continued with the bytes
+ * that follow as long as the bytes added before were a multiple of 4.
+ *
+ * @param sum The sum so far, 0 to start a new one
+ * @param data The bytes
+ * @param len Number of bytes
+ * @return uint64_t the new sum, to be folded with ones_complement_fold()
+ */
+uint64_t ones_complement_add(uint64_t sum, const void *data, size_t len);
+
+/**
+ * @brief Add bytes to a one's complement sum, 8 bytes at a time
+ *
+ * Same as ones_complement_add(), on any CPU.
+ *
+ * @param sum The sum so far
+ * @param data The bytes
+ * @param len Number of bytes
+ * @return uint64_t the new sum
+ */
+uint64_t ones_complement_add_words(uint64_t sum, const void *data,
+                                   size_t len);
+
+#if defined(__x86_64__) || defined(__i386__)
+/**
+ * @brief Add bytes to a one's complement sum, 32 bytes at a time with AVX2
+ *
+ * Same as ones_complement_add(), only on CPUs with AVX2.
+ *
+ * @param sum The sum so far
+ * @param data The bytes
+ * @param len Number of bytes
+ * @return uint64_t the new sum
+ */
+uint64_t ones_complement_add_avx2(uint64_t sum, const void *data, size_t len);
+#endif
+
+/**
+ * @brief Fold a one's complement sum to 16 bits
+ *
+ * @param sum The sum
+ * @return uint16_t the sum of the 16 bit words, in memory order
+ */
+uint16_t ones_complement_fold(uint64_t sum);
+
+/**
+ * @brief Add bytes to a CRC32C
+ *
+ * @param crc The CRC so far, ~0 to start a new one
+ * @param data The bytes
+ * @param len Number of bytes
+ * @return uint32_t the new CRC, to be inverted once every byte was added
+ */
+uint32_t crc32c_update(uint32_t crc, const void *data, size_t len);
+
+/**
+ * @brief Add bytes to a CRC32C, one bit at a time
+ *
+ * Same as crc32c_update(), on any CPU.
+ *
+ * @param crc The CRC so far
+ * @param data The bytes
+ * @param len Number of bytes
+ * @return uint32_t the new CRC
+ */
+uint32_t crc32c_update_bits(uint32_t crc, const void *data, size_t len);
+
+#if defined(__x86_64__) || defined(__i386__)
+/**
+ * @brief Add bytes to a CRC32C with the SSE4.2 crc32 instruction
+ *
+ * Same as crc32c_update(), only on CPUs with SSE4.2.
+ *
+ * @param crc The CRC so far
+ * @param data The bytes
+ * @param len Number of bytes
+ * @return uint32_t the new CRC
+ */
+uint32_t crc32c_update_sse42(uint32_t crc, const void *data, size_t len);
+#endif
+
+#endif // CHECKSUM_H
@@ -0,0 +1,175 @@
+/**
+ * @file congestion_control.h
+ * @brief Function prototypes for the pluggable congestion control algorithms
+ *
+ * This header file contains the congestion control interface used by the
+ * sender, made of hooks that are called when segments are acknowledged, when
+ * a loss is detected and when the retransmission timeout expires, and of a
+ * pacing rate. The AIMD, CUBIC and BBR algorithms implement it.
+ *
+ * @author Ritam Singal (ritamsingal)
+ * @author Harshil Patel (harshil-patel11)
+ * @bug No known bugs
+ */
+
+#ifndef CONGESTION_CONTROL_H
+#define CONGESTION_CONTROL_H
+
+#include <stdint.h>
+
+/**
+ * @brief Enum representing the available congestion control algorithms
+ */
+typedef enum cc_algorithm {
+  CC_AIMD = 0,  // additive increase by 2 per window, halve on loss
+  CC_CUBIC = 1, // RFC 8312 CUBIC
+  CC_BBR = 2    // model based on bottleneck bandwidth and minimum RTT
+} cc_algorithm_t;
+
+/**
+ * @brief Structure holding the state of the CUBIC algorithm
+ */
+typedef struct cubic_state {
+  double w_max;      // window before the last reduction
+  double k;          // time to grow back to w_max in seconds
+  uint64_t epoch_us; // start of the current growth epoch, 0 if none
+  double w_est;      // window a standard TCP flow would have
+  long min_rtt_us;   // smallest RTT seen
+} cubic_state_t;
+
+// number of bandwidth samples kept by the BBR max filter
+#define BBR_BW_SAMPLES 10
+
+/**
+ * @brief Enum representing the phases of the BBR algorithm
+ */
+typedef enum bbr_mode {
+  BBR_STARTUP = 0,  // grow quickly until the bandwidth stops increasing
+  BBR_DRAIN = 1,    // empty the queue built during startup
+  BBR_PROBE_BW = 2, // cycle the pacing gain around the bandwidth estimate
+  BBR_PROBE_RTT = 3 // shrink the window to measure the minimum RTT again
+} bbr_mode_t;
+
+/**
+ * @brief Structure holding the state of the BBR algorithm
+ */
+typedef struct bbr_state {
+  bbr_mode_t mode;
+  double bw_samples[BBR_BW_SAMPLES]; // delivery rates in segments per second
+  int bw_index;                      // next slot of bw_samples to overwrite
+  double max_bw;                     // bottleneck bandwidth estimate
+  long min_rtt_us;                   // minimum RTT estimate
+  uint64_t min_rtt_stamp_us;         // when min_rtt_us was measured
+  uint64_t round_start_us;           // start of the current delivery round
+  uint64_t delivered_in_round;       // segments acknowledged in this round
+  double full_bw;                    // bandwidth when startup last grew
+  int full_bw_rounds;                // rounds without bandwidth growth
+  int cycle_index;                   // position in the PROBE_BW gain cycle
+  uint64_t probe_rtt_done_us;        // end of the PROBE_RTT phase
+  double pacing_gain;
+  double cwnd_gain;
+} bbr_state_t;
+
+typedef struct congestion_control congestion_control_t;
+
+/**
+ * @brief Structure holding the hooks of a congestion control algorithm
+ */
+typedef struct congestion_ops {
+  const char *name;
+  void (*init)(congestion_control_t *cc);
+  void (*on_ack)(congestion_control_t *cc, int num_acked, long rtt_us,
+                 uint32_t in_flight, uint64_t now_us);
+  void (*on_loss)(congestion_control_t *cc, uint64_t now_us);
+  void (*on_timeout)(congestion_control_t *cc, uint64_t now_us);
+  double (*pacing_rate)(congestion_control_t *cc);
+} congestion_ops_t;
+
+/**
+ * @brief Structure representing the congestion control state of a connection
+ */
+struct congestion_control {
+  const congestion_ops_t *ops;
+  double cwnd;     // congestion window in segments
+  double ssthresh; // slow start threshold in segments
+  int max_cwnd;    // largest window the sender can keep track of
+  union {
+    cubic_state_t cubic;
+    bbr_state_t bbr;
+  };
+};
+
+extern const congestion_ops_t aimd_ops;
+extern const congestion_ops_t cubic_ops;
+extern const congestion_ops_t bbr_ops;
+
+/**
+ * @brief Initialize the congestion control of a connection
+ *
+ * @param cc The congestion control state
+ * @param algorithm The algorithm to use
+ * @param max_cwnd The largest window the sender can keep track of
+ */
+void init_congestion_control(congestion_control_t *cc,
+                             cc_algorithm_t algorithm, int max_cwnd);
+
+/**
+ * @brief Parse the name of a congestion control algorithm
+ *
+ * @param name One of "aimd", "cubic" or "bbr"
+ * @param algorithm Pointer where the algorithm is stored
+ * @return int 0 if successful, -1 if the name is unknown
+ */
+int parse_cc_algorithm(const char *name, cc_algorithm_t *algorithm);
+
+/**
+ * @brief Report acknowledged segments
+ *
+ * @param cc The congestion control state
+ * @param num_acked The number of segments newly acknowledged
+ * @param rtt_us The RTT sample taken from the ACK, -1 if there is none
+ * @param in_flight The number of segments in flight before the ACK
+ * @param now_us The current time in microseconds
+ */
+void cc_on_ack(congestion_control_t *cc, int num_acked, long rtt_us,
+               uint32_t in_flight, uint64_t now_us);
+
+/**
+ * @brief Report a loss detected while ACKs keep arriving
+ *
+ * Called at most once per window of data.
+ *
+ * @param cc The congestion control state
+ * @param now_us The current time in microseconds
+ */
+void cc_on_loss(congestion_control_t *cc, uint64_t now_us);
+
+/**
+ * @brief Report an expired retransmission timeout
+ *
+ * Called once per timeout, however many deadlines of the segments in flight
+ * it covers, and also during a recovery from a loss.
+ *
+ * @param cc The congestion control state
+ * @param now_us The current time in microseconds
+ */
+void cc_on_timeout(congestion_control_t *cc, uint64_t now_us);
+
+/**
+ * @brief Get the congestion window
+ *
+ * @param cc The congestion control state
+ * @return int the number of segments that may be in flight, at least 1
+ */
+int cc_window(congestion_control_t *cc);
+
+/**
+ * @brief Get the rate at which segments should be sent
+ *
+ * @param cc The congestion control state
+ * @return double the pacing rate in segments per second, 0 if the algorithm
+ * does not pace
+ */
+double cc_pacing_rate(congestion_control_t *cc);
+
+#endif // CONGESTION_CONTROL_H
@@ -0,0 +1,161 @@
+/**
+ * @file event_loop.h
+ * @brief Function prototypes for an epoll event loop with timers
+ *
+ * This header file contains the function prototypes for watching descriptors
+ * with epoll, arming timers backed by timerfd on the monotonic clock of
+ * get_time_us(), and running a loop that calls the handler of every source
+ * that becomes ready until a handler stops it.
+ *
+ * @author Ritam Singal (ritamsingal)
+ * @author Harshil Patel (harshil-patel11)
+ * @bug No known bugs
+ */
+
+#ifndef EVENT_LOOP_H
+#define EVENT_LOOP_H
+
+#include <stdint.h>
+#include <sys/epoll.h>
+
+#define EVENT_BATCH_SIZE 16 // ready sources handled per epoll_wait call
+#define EVENT_CONTINUE 0    // handler result that keeps the loop running
+#define EVENT_STOP 1        // handler result that stops the loop without error
+
+/**
+ * @brief Handler called when a source becomes ready
+ *
+ * @param context The context the source was registered with
+ * @param events The epoll events that are ready
+ * @return int EVENT_CONTINUE to keep the loop running, any other value stops
+ * the loop and is returned by run_event_loop()
+ */
+typedef int (*event_handler_t)(void *context, uint32_t events);
+
+/**
+ * @brief Structure representing a descriptor watched by an event loop
+ *
+ * The source is owned by the caller and has to stay at the same address while
+ * it is registered.
+ */
+typedef struct event_source {
+  int fd;                  // watched descriptor
+  int is_timer;            // 1 if fd is a timerfd owned by the source
+  event_handler_t handler; // called when fd becomes ready
+  void *context;           // passed to the handler
+} event_source_t;
+
+/**
+ * @brief Structure representing an event loop
+ */
+typedef struct event_loop {
+  int epoll_fd; // epoll instance watching the sources
+  int running;  // 1 while the handlers of the ready sources are called
+  int result;   // value of the handler that stopped the loop
+} event_loop_t;
+
+/**
+ * @brief Create an event loop
+ *
+ * @param loop The event loop
+ * @return int 0 if successful, -1 if the epoll instance could not be created
+ */
+int init_event_loop(event_loop_t *loop);
+
+/**
+ * @brief Close an event loop
+ *
+ * The sources are not closed, only timers own their descriptor.
+ *
+ * @param loop The event loop
+ */
+void free_event_loop(event_loop_t *loop);
+
+/**
+ * @brief Watch a descriptor
+ *
+ * The source is level-triggered: its handler is called again on the next
+ * iteration as long as the descriptor stays ready.
+ *
+ * @param loop The event loop
+ * @param source The source to register
+ * @param fd The descriptor to watch
+ * @param events The epoll events to watch for, like EPOLLIN
+ * @param handler The handler called when the descriptor becomes ready
+ * @param context The context passed to the handler
+ * @return int 0 if successful, -1 otherwise
+ */
+int add_event_source(event_loop_t *loop, event_source_t *source, int fd,
+                     uint32_t events, event_handler_t handler, void *context);
+
+/**
+ * @brief Stop watching a descriptor
+ *
+ * @param loop The event loop
+ * @param source The registered source
+ */
+void remove_event_source(event_loop_t *loop, event_source_t *source);
+
+/**
+ * @brief Create a timer and register it with an event loop
+ *
+ * The timer starts disarmed. Its handler is called with EPOLLIN once the
+ * timer fires.
+ *
+ * @param loop The event loop
+ * @param timer The source backing the timer
+ * @param handler The handler called when the timer fires
+ * @param context The context passed to the handler
+ * @return int 0 if successful, -1 otherwise
+ */
+int init_event_timer(event_loop_t *loop, event_source_t *timer,
+                     event_handler_t handler, void *context);
+
+/**
+ * @brief Unregister a timer and close its descriptor
+ *
+ * @param loop The event loop
+ * @param timer The timer
+ */
+void free_event_timer(event_loop_t *loop, event_source_t *timer);
+
+/**
+ * @brief Arm a timer
+ *
+ * A deadline that has already passed fires on the next iteration.
+ *
+ * @param timer The timer
+ * @param deadline_us Time to fire at, as returned by get_time_us(), or 0 to
+ * disarm the timer
+ * @return int 0 if successful, -1 otherwise
+ */
+int arm_event_timer(event_source_t *timer, uint64_t deadline_us);
+
+/**
+ * @brief Run an event loop
+ *
+ * Wait for the sources to become ready and call their handlers until one of
+ * them returns something other than EVENT_CONTINUE.
+ *
+ * @param loop The event loop
+ * @return int the value returned by the handler that stopped the loop, or -1
+ * if waiting for events failed
+ */
+int run_event_loop(event_loop_t *loop);
+
+/**
+ * @brief Run one iteration of an event loop
+ *
+ * Wait up to timeout_ms for sources to become ready, once, and call the
+ * handlers of the ready ones, so that a caller with its own loop can drive
+ * the sources whenever the epoll descriptor is readable.
+ *
+ * @param loop The event loop
+ * @param timeout_ms Longest time to wait, 0 to only handle the ready sources,
+ * or -1 to wait until one is ready
+ * @return int EVENT_CONTINUE if no handler stopped the loop, the value
+ * returned by the handler that stopped it, or -1 if waiting for events failed
+ */
+int poll_event_loop(event_loop_t *loop, int timeout_ms);
+
+#endif // EVENT_LOOP_H
@@ -0,0 +1,117 @@
+#ifndef FAST_OPEN_H
+#define FAST_OPEN_H
+
+/**
+ * @file fast_open.h
+ *
+ * @brief Function prototypes for fast open cookies
+ *
+ * This header file contains the function prototypes for the cookies that let
+ * a sender send its first window right behind the SYN. The receiver issues a
+ * cookie in the SYN-ACK, computed with SipHash-2-4 from a secret key and the
+ * address of the sender, so only a sender that received a SYN-ACK at that
+ * address knows it. The sender keeps the cookie of each receiver in a file,
+ * together with the segment size of the connection, and presents it in the
+ * SYN of its next connection.
+ *
+ * https://www.aumasson.jp/siphash/siphash.pdf
+ *
+ * @author Ritam Singal (ritamsingal)
+ * @author Harshil Patel (harshil-patel11)
+ * @bug No known bugs
+ */
+
+#include <netinet/in.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#define FAST_OPEN_COOKIE_SIZE 8 // bytes of a cookie on the wire
+
+/**
+ * @brief Structure holding the cookie a receiver issued to this sender
+ */
+typedef struct fast_open_cookie {
+  uint64_t cookie;       // cookie presented in the SYN, never 0
+  uint16_t segment_size; // segment size the receiver accepted with it
+} fast_open_cookie_t;
+
+/**
+ * @brief Compute the SipHash-2-4 of a buffer
+ *
+ * @param key The 128 bit secret key
+ * @param data The bytes
+ * @param len Number of bytes
+ * @return uint64_t the hash
+ */
+uint64_t siphash24(const uint64_t key[2], const void *data, size_t len);
+
+/**
+ * @brief Generate a random secret key for cookies
+ *
+ * @param key The key to fill
+ */
+void init_fast_open_key(uint64_t key[2]);
+
+/**
+ * @brief Load the secret key for cookies from a key file
+ *
+ * A file that does not exist yet is created with a new random key, written
+ * to a temporary file that is renamed into place, so a receiver keeps its
+ * key, and the cookies it issued stay valid, across restarts.
+ *
+ * @param path The key file
+ * @param key The key to fill
+ * @return int 0 if successful, -1 if the file could not be read or written
+ */
+int load_fast_open_key(const char *path, uint64_t key[2]);
+
+/**
+ * @brief Compute the cookie of a sender
+ *
+ * @param key The secret key of the receiver
+ * @param client_addr The address of the sender, its port is ignored
+ * @return uint64_t the cookie, never 0
+ */
+uint64_t make_fast_open_cookie(const uint64_t key[2],
+                               struct sockaddr_in *client_addr);
+
+/**
+ * @brief Pick the initial sequence number of a connection
+ *
+ * The number is hard to guess for anyone who does not see the SYN-ACK, so a
+ * data segment echoing it comes from the address of the connection.
+ *
+ * @param key The secret key of the receiver
+ * @param client_addr The address and port of the sender
+ * @return uint32_t the initial sequence number, never 0
+ */
+uint32_t make_connection_isn(const uint64_t key[2],
+                             struct sockaddr_in *client_addr);
+
+/**
+ * @brief Look up the cookie of a receiver in a cookie file
+ *
+ * @param path The cookie file
+ * @param server_addr The address and port of the receiver
+ * @param cookie The cookie to fill
+ * @return int 1 if the file holds a cookie for the receiver, 0 otherwise
+ */
+int load_fast_open_cookie(const char *path, struct sockaddr_in *server_addr,
+                          fast_open_cookie_t *cookie);
+
+/**
+ * @brief Store the cookie of a receiver in a cookie file
+ *
+ * The file is rewritten with the cookie replacing the previous one of the
+ * receiver, and renamed over the old file, so concurrent senders never see
+ * half of it.
+ *
+ * @param path The cookie file
+ * @param server_addr The address and port of the receiver
+ * @param cookie The cookie
+ * @return int 0 if successful, -1 if the file could not be written
+ */
+int store_fast_open_cookie(const char *path, struct sockaddr_in *server_addr,
+                           fast_open_cookie_t *cookie);
+
+#endif // FAST_OPEN_H
@@ -0,0 +1,86 @@
+/**
+ * @file file_digest.h
+ * @brief Function prototypes for the digest of a transferred file
+ *
+ * This header file contains the function prototypes for XXH64, a fast
+ * non-cryptographic 64 bit hash that can be computed over a stream of bytes,
+ * and for the digest of a file built from it. The digest is the XXH64 of the
+ * XXH64 of every segment's payload in sequence order, so the receiver can
+ * hash each segment when it arrives, even out of order, and add it to the
+ * digest once the segments before it arrived.
+ *
+ * @author Ritam Singal (ritamsingal)
+ * @author Harshil Patel (harshil-patel11)
+ * @bug No known bugs
+ */
+
+#ifndef FILE_DIGEST_H
+#define FILE_DIGEST_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * @brief Structure holding an XXH64 computed over a stream of bytes
+ */
+typedef struct xxh64_state {
+  uint64_t total_len;     // bytes added so far
+  uint64_t seed;          // seed the hash started from
+  uint64_t lanes[4];      // accumulators of the 32 byte stripes
+  unsigned char buf[32];  // bytes that do not fill a stripe yet
+  size_t buf_len;         // number of bytes in buf
+} xxh64_state_t;
+
+/**
+ * @brief Start an XXH64
+ *
+ * @param state The hash
+ * @param seed The seed
+ */
+void xxh64_init(xxh64_state_t *state, uint64_t seed);
+
+/**
+ * @brief Add bytes to an XXH64
+ *
+ * @param state The hash
+ * @param data The bytes
+ * @param len Number of bytes
+ */
+void xxh64_update(xxh64_state_t *state, const void *data, size_t len);
+
+/**
+ * @brief Get the XXH64 of the bytes added so far
+ *
+ * The state is not changed, so more bytes may still be added.
+ *
+ * @param state The hash
+ * @return uint64_t the hash
+ */
+uint64_t xxh64_digest(const xxh64_state_t *state);
+
+/**
+ * @brief Compute the XXH64 of a buffer
+ *
+ * @param data The bytes
+ * @param len Number of bytes
+ * @param seed The seed
+ * @return uint64_t the hash
+ */
+uint64_t xxh64(const void *data, size_t len, uint64_t seed);
+
+/**
+ * @brief Start the digest of a file
+ *
+ * @param digest The digest
+ */
+void init_file_digest(xxh64_state_t *digest);
+
+/**
+ * @brief Add the hash of the next segment to the digest of a file
+ *
+ * @param digest The digest
+ * @param segment_hash The XXH64 of the payload of the segment, with seed 0
+ */
+void add_segment_hash(xxh64_state_t *digest, uint64_t segment_hash);
+
+#endif // FILE_DIGEST_H
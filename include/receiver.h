@@ -7,72 +7,572 @@
  * @brief Function prototypes for the receiver
  *
  * This header file contains the function prototypes for receiving a file from a
- * sender, flushing data to file, sending an ACK to the sender, establishing a
- * connection with the sender, and closing the connection with the sender.
+ * sender from an event loop, writing data to file, sending an ACK to the
+ * sender, establishing a connection with the sender, and closing the
+ * connection with the sender.
  *
  * @author Ritam Singal (ritamsingal)
  * @author Harshil Patel (harshil-patel11)
  * @bug No known bugs
  */
 
+#include <pthread.h>
 #include <stdio.h>
 #include <stdlib.h>
 
+#include "event_loop.h"
+#include "file_digest.h"
+#include "tcp_io.h"
 #include "tcp_segment.h"
 #include "tcp_utils.h"
 
+#define DEFAULT_ACK_EVERY 2          // segments acknowledged by one ACK
+#define DEFAULT_ACK_DELAY_US 500     // longest time an ACK is held back
+#define DEFAULT_RECEIVE_WINDOW 8192  // segments held by the receive buffer
+#define DEFAULT_MAX_CONNECTIONS 64   // transfers served at once in server mode
+#define CONNECTION_TABLE_SIZE 256    // buckets of the connection table
+#define CONNECTION_LINGER_US 2000000 // time a closed connection answers FINs
+#define MAX_RECEIVER_WORKERS 64      // worker threads of a server
+#define WRITE_BURST_US 10000         // most credit of a writer, in time at rate
+#define WRITE_INTERVAL_US 1000       // shortest sleep of a rate limited writer
+
+/**
+ * @brief Structure holding the options of the receiver
+ */
+typedef struct receiver_options {
+  int ack_every;             // unacknowledged segments that trigger an ACK
+  long ack_delay_us;         // longest time an ACK is held back
+  uint32_t window_segments;  // size of the receive buffer in segments
+  uint16_t max_segment_size; // largest segment payload accepted
+  int offload;               // 1 to receive coalesced trains with UDP GRO
+  io_engine_t io_engine;     // system calls segments and writes are moved with
+  int server;                // 1 to keep serving transfers from many senders
+  uint32_t max_connections;  // transfers served at once in server mode
+  uint32_t num_workers;      // threads serving transfers in server mode
+  int stream;                // 1 to hold the data for the application
+  uint64_t cookie_key[2];    // secret key of the fast open cookies
+  char *cookie_key_file;     // file the key is kept in, NULL for a new key
+} receiver_options_t;
+
+/**
+ * @brief Structure representing the receiver's reorder buffer
+ *
+ * The buffer accepts the segments in [base_seq, base_seq + num_segments).
+ * Each segment is written to its offset in the output file as soon as it
+ * arrives, so the buffer only records which segments it has seen. The stream
+ * of a striped transfer starts at file_offset instead of the start of the
+ * file. Segment seq_number is tracked by bit seq_number % num_segments of
+ * seq_bitmap, so the buffer slides forward without moving any data. The hash
+ * of each received payload waits in its slot until the buffer slides past it
+ * and it is added to the digest of the file, in sequence order.
+ *
+ * The buffer of a byte stream has no file. Its slots hold the payloads
+ * instead, and the segments the buffer slid past keep their slots until the
+ * application reads them, so the window only reaches num_segments past
+ * read_seq. The buffer of a file written at a limited rate holds its payloads
+ * the same way, until the writer reaches them, so a slow writer shrinks the
+ * window the sender sees.
+ */
+typedef struct receive_buffer {
+  uint64_t *seq_bitmap;     // one bit per slot, set for the received segments
+  uint64_t *segment_hashes; // XXH64 of the payload of each received segment
+  xxh64_state_t digest;     // digest of the segments below base_seq
+  char *data;               // held payloads, segment_size bytes a slot
+  uint16_t *segment_lens;   // payload bytes in each slot with a payload
+  uint32_t read_seq;        // first segment not read or written yet
+  uint16_t read_offset;     // bytes of segment read_seq that were read
+  uint32_t num_segments;    // number of slots
+  uint16_t segment_size;    // negotiated payload size of a segment
+  uint32_t base_seq;        // lowest sequence number not received yet
+  uint32_t end_seq;         // one past the highest received sequence number
+  int file_desc;            // output file the segments are written to
+  uint64_t file_offset;     // offset of sequence number 0 in the output file
+  tcp_io_t *io;             // batch the writes are submitted with
+} receive_buffer_t;
+
+/**
+ * @brief Structure holding the state of one transfer from one sender
+ *
+ * Connections are kept in the table of the receiver, keyed by the address and
+ * port of the sender. A closed connection lingers for CONNECTION_LINGER_US to
+ * answer a retransmitted FIN, and is freed by its own timer.
+ */
+typedef struct connection {
+  struct sockaddr_in addr;         // address and port of the sender
+  struct receiver_state *receiver; // receiver the connection belongs to
+  FILE *output_file;               // NULL once the connection is closed
+  receive_buffer_t file_buffer;
+  event_source_t timer;       // delayed ACK, writer, or end of the linger
+  uint64_t ack_deadline_us;   // time the ACK is sent at, or 0
+  uint64_t write_deadline_us; // time the rate limited writer resumes, or 0
+  int pending_acks;         // segments received since the last ACK
+  uint32_t ts_recent;       // timestamp echoed back by the next ACK
+  uint8_t checksum_type;    // checksum accepted for the data segments
+  uint32_t isn;             // sequence number of the SYN-ACK, never 0
+  int fast_open;            // 1 if the SYN carried a valid cookie
+  int fin_pending;          // 1 if the FIN-ACK waits for the writer
+  int closed;               // 1 once the connection is closed
+  int digest_mismatch;      // 1 if the file differs from the one sent
+  int error;                // error that closed the connection, or SUCCESS
+  struct connection *next;  // next connection in the same bucket
+  // next connection waiting to be accepted, if the connection is queued
+  struct connection *next_accept;
+} connection_t;
+
+/**
+ * @brief Structure holding the token bucket of a rate limited receiver
+ *
+ * Every connection of every worker takes its writes from the one bucket, so
+ * the rate limits the total written to disk, however many senders and
+ * streams there are. The lock only guards the credit, the writes themselves
+ * happen outside of it.
+ */
+typedef struct write_bucket {
+  pthread_mutex_t lock;
+  uint64_t rate;    // bytes per second written by the whole receiver
+  uint64_t time_us; // time credit was last topped up
+  double credit;    // bytes the writers may write now, below 0 if overdrawn
+} write_bucket_t;
+
+/**
+ * @brief Structure holding the state of a receiver driven by an event loop
+ *
+ * The loop calls handle_receiver_socket() when segments arrive, and the timer
+ * of each connection calls handle_connection_timer(). A server runs one state
+ * per worker thread, each with its own socket bound to the same port, and
+ * the kernel hands every sender to one of them, so workers share nothing. A
+ * receiver of byte streams queues its new connections until the application
+ * accepts them.
+ */
+typedef struct receiver_state {
+  receiver_options_t *options;
+  unsigned short int port;  // UDP port the socket is bound to
+  char *ip;                 // address the socket is bound to
+  uint32_t max_connections; // transfers this worker serves at once
+  pthread_t thread;         // thread running the worker
+  int retval;               // 0 once the worker stopped without error
+  int socket_desc;
+  char *filename;    // output file, or prefix of the files in server mode
+  FILE *output_file; // file opened for the only transfer, or NULL
+  write_bucket_t *write_bucket; // shared by the workers, NULL without a rate
+  tcp_io_t io;                  // batch segments are received into
+  event_loop_t *loop;
+  event_source_t socket_source;
+  // connections chained in buckets by the hash of the sender address
+  connection_t *connections[CONNECTION_TABLE_SIZE];
+  uint32_t num_connections;
+  connection_t *last_connection; // connection of the previous segment
+  // the only transfer without -s may come as several streams
+  uint32_t transfer_id;        // transfer whose streams are accepted
+  uint16_t num_streams;        // streams of the transfer, 0 before its SYN
+  uint16_t num_closed_streams; // streams whose FIN arrived
+  // connections of byte streams not accepted yet, oldest first
+  connection_t *accept_head;
+  connection_t *accept_tail;
+} receiver_state_t;
+
+/**
+ * @brief Initialize receiver options to their defaults
+ *
+ * @param options The options to initialize
+ */
+void init_receiver_options(receiver_options_t *options);
+
 /**
  * @brief Receive a file from a sender
  *
  * Receive a file from a sender given the UDP port, destination file and
- * writeRate.
+ * writeRate. With a writeRate the received data waits in the receive buffer
+ * until it is written at that rate, and the window advertised to the sender
+ * shrinks while the buffer fills up, so the sender slows down to the rate.
  *
  * @param myUDPport The UDP port of the receiver
  * @param destinationFile The name of the file to write
- * @param writeRate The rate at which to write the file
+ * @param writeRate The rate at which to write the file in bytes per second,
+ * or 0 to write every segment as soon as it arrives
  */
 void rrecv(unsigned short int myUDPport, char *destinationFile,
            unsigned long long int writeRate);
 
 /**
- * @brief flush data to file
+ * @brief Receive a file from a sender with the given options
+ *
+ * Same as rrecv(), but the receiver is configured by options instead of the
+ * defaults.
+ *
+ * @param myUDPport The UDP port of the receiver
+ * @param destinationFile The name of the file to write
+ * @param writeRate The rate at which the receiver writes in bytes per second,
+ * shared by all senders and streams, or 0 for no limit
+ * @param options The options of the receiver
+ * @return int 0 if every transfer was received, -1 if the receiver could not
+ * run or a transfer failed
+ */
+int rrecv_with_options(unsigned short int myUDPport, char *destinationFile,
+                       unsigned long long int writeRate,
+                       receiver_options_t *options);
+
+/**
+ * @brief run one receiver on the calling thread
+ *
+ * Bind a socket to the port of the receiver, with SO_REUSEPORT when it has
+ * several workers, and serve the senders that reach it from an event loop
+ * until the only transfer is done or an error stops the loop.
+ *
+ * @param state The receiver, with its options, port, address and output file
+ * set
+ * @return int 0 if successful, -1 otherwise
+ */
+int run_receiver(receiver_state_t *state);
+
+/**
+ * @brief set up a receiver without running it
+ *
+ * Bind the socket of the receiver and register it with an event loop that
+ * the caller runs. The output file is closed if anything fails.
+ *
+ * @param state The receiver, with its options, port, address and output file
+ * set
+ * @param loop The event loop to create
+ * @return int 0 if successful, -1 otherwise
+ */
+int start_receiver(receiver_state_t *state, event_loop_t *loop);
+
+/**
+ * @brief tear down a receiver set up by start_receiver()
  *
- * Flush data to file based on the file buffer and file buffer sequence
+ * Free every connection, the event loop and the socket, and close the output
+ * file.
  *
- * @param file The file to write to
- * @param file_buffer The buffer to write to the file
- * @param file_buffer_seq The sequence of the file buffer. This is used to mask
- * the file buffer which is split into multiple segments of SEGMENT_DATA_SIZE
- * size. Only the segments marked with 1 in the file_buffer_seq are written to
- * the file.
- * @return int number of packets (only the data) flushed to file
+ * @param state The receiver
  */
-int flush_packets_to_file(FILE *file, char *file_buffer, int *file_buffer_seq);
+void stop_receiver(receiver_state_t *state);
+
+/**
+ * @brief thread entry point of a worker of a server
+ *
+ * @param arg The receiver state of the worker, its retval is set to the
+ * result of run_receiver()
+ * @return void* NULL
+ */
+void *receiver_worker(void *arg);
+
+/**
+ * @brief event loop handler for segments arriving on the socket
+ *
+ * Receive one batch without waiting and handle every segment in it with
+ * process_segment().
+ *
+ * @param context The receiver
+ * @param events The ready epoll events
+ * @return int EVENT_CONTINUE, EVENT_STOP once the connection is closed, or
+ * the error that ends the transfer
+ */
+int handle_receiver_socket(void *context, uint32_t events);
+
+/**
+ * @brief event loop handler for the timer of a connection
+ *
+ * Send the ACK of the segments received since the last one, if any, let a
+ * rate limited writer write what its rate allows, or free the connection once
+ * its linger time is over. A connection whose FIN was answered while its
+ * writer was behind is closed once the writer caught up.
+ *
+ * @param context The connection
+ * @param events The ready epoll events
+ * @return int EVENT_CONTINUE, EVENT_STOP once the last stream of the only
+ * transfer is written, or the error that ends the transfer
+ */
+int handle_connection_timer(void *context, uint32_t events);
+
+/**
+ * @brief handle one segment from a sender
+ *
+ * A SYN opens a connection for its sender and is answered with a SYN-ACK, a
+ * FIN is answered with a FIN-ACK once every write is done, or once a rate
+ * limited writer holds every segment in its buffer, and data is written
+ * to the file of the connection and acknowledged. ACKs are delayed until
+ * ack_every segments arrived or the ACK timer fires, unless a segment arrives
+ * out of order. A segment beyond the receive buffer is not taken, but answered
+ * right away with the current window. Segments of senders without a
+ * connection are ignored.
+ *
+ * @param state The receiver
+ * @param client_segment The segment
+ * @param client_addr The address of the sender
+ * @return int EVENT_CONTINUE, EVENT_STOP once the FIN-ACK of the last stream
+ * of the only transfer is sent, or the error that ends the transfer
+ */
+int process_segment(receiver_state_t *state, tcp_segment_t *client_segment,
+                    struct sockaddr_in *client_addr);
+
+/**
+ * @brief hash a sender address into a bucket of the connection table
+ *
+ * @param client_addr The address and port of the sender
+ * @return uint32_t the bucket
+ */
+uint32_t connection_bucket(struct sockaddr_in *client_addr);
+
+/**
+ * @brief find the connection of a sender
+ *
+ * @param state The receiver
+ * @param client_addr The address and port of the sender
+ * @return connection_t* the connection, NULL if the sender has none
+ */
+connection_t *find_connection(receiver_state_t *state,
+                              struct sockaddr_in *client_addr);
+
+/**
+ * @brief open a connection for a sender
+ *
+ * Open the output file of the connection, allocate its receive buffer for the
+ * negotiated segment size, and add it to the table. In server mode the output
+ * file is named after the sender, filename.address.port. The streams of a
+ * striped transfer share one file, filename.address.transfer_id in server
+ * mode, which each of them opens without truncating it and writes from the
+ * offset of its stream. A byte stream has no file, its connection is queued
+ * to be accepted instead.
+ *
+ * @param state The receiver
+ * @param client_addr The address and port of the sender
+ * @param syn_options The options of the SYN, with the negotiated segment size
+ * @return connection_t* the connection, NULL if the table is full, the SYN
+ * does not belong to the only transfer, or the connection could not be set up
+ */
+connection_t *open_connection(receiver_state_t *state,
+                              struct sockaddr_in *client_addr,
+                              syn_options_t *syn_options);
+
+/**
+ * @brief close a connection
+ *
+ * Wait for the queued writes, close the output file, and let the connection
+ * linger so that it can still answer its sender. The connection of a byte
+ * stream keeps its data until the application frees it.
+ *
+ * @param connection The connection
+ * @param linger_us Time until the connection is freed
+ * @return int 0 if successful, -1 if a write failed
+ */
+int close_connection(connection_t *connection, uint64_t linger_us);
+
+/**
+ * @brief arm the timer of a connection for its earliest deadline
+ *
+ * @param connection The connection
+ * @return int 0 if successful, -1 if the timer could not be armed
+ */
+int arm_connection_timer(connection_t *connection);
+
+/**
+ * @brief write the data of a connection at the write rate of its receiver
+ *
+ * Top up the credit of the shared bucket for the time since it was last
+ * topped up, write the held segments it pays for, and set the time the writer
+ * resumes if segments are left. Writers that drew on the same credit at once
+ * overdraw it, and wait for the debt to be paid before they write again. A sender stopped by the full buffer learns that it drained from
+ * an ACK, which is sent once half of the buffer is free rather than for every
+ * write.
+ *
+ * @param connection The connection, whose buffer holds its payloads
+ * @return int SUCCESS, WRITE_FAILED if a write failed, or SEND_FAILED if the
+ * ACK could not be sent
+ */
+int write_connection_data(connection_t *connection);
+
+/**
+ * @brief remove a connection from the table and free it
+ *
+ * The connection is also removed from the accept queue if it is still in it.
+ *
+ * @param state The receiver
+ * @param connection The connection
+ */
+void free_connection(receiver_state_t *state, connection_t *connection);
+
+/**
+ * @brief give up on a connection after an error
+ *
+ * In server mode the connection is closed and the other transfers go on, with
+ * a single transfer the error ends the receiver. The error is kept in the
+ * connection.
+ *
+ * @param connection The connection
+ * @param error The error
+ * @return int EVENT_CONTINUE in server mode, error otherwise
+ */
+int fail_connection(connection_t *connection, int error);
+
+/**
+ * @brief Allocate a receive buffer
+ *
+ * @param buffer The receive buffer
+ * @param num_segments The number of segments the buffer holds
+ * @param segment_size The negotiated payload size of a segment
+ * @param file_desc The output file the segments are written to, or -1 to hold
+ * the payloads of a byte stream in the buffer
+ * @param hold_data 1 to hold the payloads of a file in the buffer until they
+ * are written by write_receive_buffer()
+ * @param io The batch the writes are submitted with
+ * @return int 0 if successful, -1 if the buffer could not be allocated
+ */
+int init_receive_buffer(receive_buffer_t *buffer, uint32_t num_segments,
+                        uint16_t segment_size, int file_desc, int hold_data,
+                        tcp_io_t *io);
+
+/**
+ * @brief Free the memory of a receive buffer
+ *
+ * @param buffer The receive buffer
+ */
+void free_receive_buffer(receive_buffer_t *buffer);
+
+/**
+ * @brief Write a data segment to file
+ *
+ * Write the data of a segment at its offset in the output file, file_offset +
+ * seq_number * segment_size, if it falls within the buffer and was not
+ * received before. The write goes through the batch, so with the io_uring
+ * engine it may only be submitted with the next batch. A buffer that holds its
+ * payloads copies the payload to its slot instead.
+ *
+ * @param buffer The receive buffer
+ * @param client_segment The data segment received from the sender
+ * @return int 0 if successful, -1 if the data could not be written
+ */
+int process_data(receive_buffer_t *buffer, tcp_segment_t *client_segment);
+
+/**
+ * @brief read the in-order data of a byte stream
+ *
+ * Copy the payloads of the segments the buffer slid past to the application,
+ * and free the slots that were read completely.
+ *
+ * @param buffer The receive buffer of the stream
+ * @param data Buffer the bytes are copied to
+ * @param len Size of data
+ * @return size_t number of bytes copied, 0 if no in-order data is waiting
+ */
+size_t read_receive_buffer(receive_buffer_t *buffer, char *data, size_t len);
+
+/**
+ * @brief write the held in-order data of a file
+ *
+ * Write the payloads of the segments the buffer slid past to the output file,
+ * oldest first, and free their slots. Only whole segments are written.
+ *
+ * @param buffer The receive buffer, holding its payloads
+ * @param max_bytes Most bytes to write
+ * @return ssize_t number of bytes written, or -1 if a write failed
+ */
+ssize_t write_receive_buffer(receive_buffer_t *buffer, size_t max_bytes);
+
+/**
+ * @brief check the digest carried by a FIN
+ *
+ * Compare the digest of the segments the buffer slid past with the digest of
+ * the segments the sender sent, carried by its FIN. Every segment was
+ * received by the time the sender closes, so both cover the whole file.
+ *
+ * @param buffer The receive buffer
+ * @param fin_segment The FIN received from the sender
+ * @return int 1 if the digests match or the FIN carries none, 0 otherwise
+ */
+int check_file_digest(receive_buffer_t *buffer, tcp_segment_t *fin_segment);
+
+/**
+ * @brief check whether a segment was received
+ *
+ * @param buffer The receive buffer
+ * @param seq_number The sequence number of the segment, within the buffer
+ * @return int 1 if the segment was received, 0 otherwise
+ */
+int is_segment_received(receive_buffer_t *buffer, uint32_t seq_number);
+
+/**
+ * @brief slide the buffer past the in-order segments
+ *
+ * Advance base_seq past the segments at the start of the receive buffer that
+ * were received, and free their slots for new segments.
+ *
+ * @param buffer The receive buffer
+ * @return int number of segments the buffer slid past
+ */
+int advance_receive_buffer(receive_buffer_t *buffer);
+
+/**
+ * @brief check for segments received out of order
+ *
+ * @param buffer The receive buffer
+ * @return int 1 if a segment was received behind a missing one, 0 otherwise
+ */
+int has_out_of_order_segments(receive_buffer_t *buffer);
+
+/**
+ * @brief get the receive window to advertise
+ *
+ * @param buffer The receive buffer
+ * @return uint32_t number of segments, starting at the cumulative ACK number,
+ * that the sender may have in flight, less the held segments that were not
+ * read or written yet
+ */
+uint32_t advertised_window(receive_buffer_t *buffer);
 
 /**
  * @brief Send an ACK to sender
  *
- * Send a TCP ACK to the sender.
+ * Send a TCP ACK to the sender. The ACK number is cumulative: it is the next
+ * sequence number the receiver expects. Segments that were received beyond it
+ * are reported in SACK blocks, and the free space of the receive buffer is
+ * advertised as the window. One ACK may acknowledge several segments.
  *
  * @param socket_desc The socket descriptor
- * @param client_segment The segment received from the client
  * @param client_addr The address of the client
+ * @param buffer The receive buffer
+ * @param ts_ecr The timestamp of the sender's segment to echo back
  * @return tcp_error_t
  */
-tcp_error_t send_ack(int socket_desc, tcp_segment_t *client_segment,
-                     struct sockaddr_in *client_addr);
+tcp_error_t send_ack(int socket_desc, struct sockaddr_in *client_addr,
+                     receive_buffer_t *buffer, uint32_t ts_ecr);
+
+/**
+ * @brief fill the SACK blocks of an ACK
+ *
+ * Describe each contiguous run of received segments as a SACK block, starting
+ * from the lowest one, until MAX_SACK_BLOCKS blocks are used.
+ *
+ * @param segment The ACK segment to fill
+ * @param buffer The receive buffer
+ */
+void fill_sack_blocks(tcp_segment_t *segment, receive_buffer_t *buffer);
 
 /**
  * @brief establish a connection with the sender
  *
  * Establish a reliable connection with the sender in order to receive data.
+ * The SYN-ACK advertises the initial receive window and the segment size the
+ * receive buffer was allocated for, and accepts a checksum for the data. Its
+ * sequence number is the initial sequence number of the receiver, and it
+ * acknowledges the segments that arrived before it, which a sender using fast
+ * open may already have sent.
  *
  * @param socket_desc The socket descriptor
  * @param client_addr The address of the sender
+ * @param ts_ecr The timestamp of the SYN to echo back
+ * @param buffer The receive buffer
+ * @param checksum_type The checksum accepted for the data segments
+ * @param isn The initial sequence number of the receiver
+ * @param cookie The fast open cookie issued to the sender, or 0 for none
  * @return tcp_error_t
  */
 tcp_error_t establish_connection_receiver(int socket_desc,
-                                          struct sockaddr_in *client_addr);
+                                          struct sockaddr_in *client_addr,
+                                          uint32_t ts_ecr,
+                                          receive_buffer_t *buffer,
+                                          checksum_type_t checksum_type,
+                                          uint32_t isn, uint64_t cookie);
 
 /**
  * @brief close the connection with the sender
@@ -81,9 +581,47 @@ tcp_error_t establish_connection_receiver(int socket_desc,
  *
  * @param socket_desc The socket descriptor
  * @param client_addr The address of the sender
+ * @param ts_ecr The timestamp of the FIN to echo back
  * @return tcp_error_t
  */
 tcp_error_t close_connection_receiver(int socket_desc,
-                                      struct sockaddr_in *client_addr);
+                                      struct sockaddr_in *client_addr,
+                                      uint32_t ts_ecr);
+
+/**
+ * @brief acknowledge the FIN of a sender without closing the connection
+ *
+ * Tell a sender that its FIN arrived while the held data is still written,
+ * so it keeps waiting for the FIN-ACK. The ACK acknowledges one past the
+ * sequence number of the FIN, which no ACK for data reaches.
+ *
+ * @param socket_desc The socket descriptor
+ * @param client_addr The address of the sender
+ * @param fin_seq The sequence number of the FIN
+ * @param ts_ecr The timestamp of the FIN to echo back
+ * @return tcp_error_t
+ */
+tcp_error_t acknowledge_fin_receiver(int socket_desc,
+                                     struct sockaddr_in *client_addr,
+                                     uint32_t fin_seq, uint32_t ts_ecr);
+
+/**
+ * @brief reset the connection with the sender
+ *
+ * Answer a sender with a RST instead of a FIN-ACK, so it knows the transfer
+ * failed. The payload is one byte with the reason: RST_REASON_DIGEST_MISMATCH
+ * if the file digest does not match, RST_REASON_WRITE_FAILED if the data held
+ * after the FIN could not be written, RST_REASON_CLOSED if the application
+ * closed the connection before the sender did.
+ *
+ * @param socket_desc The socket descriptor
+ * @param client_addr The address of the sender
+ * @param ts_ecr The timestamp of the last segment to echo back
+ * @param reason The RST_REASON_ of the reset
+ * @return tcp_error_t
+ */
+tcp_error_t reset_connection_receiver(int socket_desc,
+                                      struct sockaddr_in *client_addr,
+                                      uint32_t ts_ecr, uint8_t reason);
 
 #endif
\ No newline at end of file
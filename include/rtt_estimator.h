@@ -0,0 +1,77 @@
+/**
+ * @file rtt_estimator.h
+ * @brief Function prototypes for estimating the round trip time and the
+ * retransmission timeout
+ *
+ * This header file contains the function prototypes for keeping a smoothed
+ * round trip time and its variation, deriving the retransmission timeout from
+ * them as described in RFC 6298, and backing the timeout off exponentially.
+ *
+ * @author Ritam Singal (ritamsingal)
+ * @author Harshil Patel (harshil-patel11)
+ * @bug No known bugs
+ */
+
+#ifndef RTT_ESTIMATOR_H
+#define RTT_ESTIMATOR_H
+
+#include <stdint.h>
+
+#define INITIAL_RTO_US 250000     // timeout used before the first RTT sample
+#define MIN_RTO_US 1000           // lower bound of the timeout
+#define TIMER_GRANULARITY_US 1000 // G of RFC 6298, covers timer and ACK jitter
+#define MAX_RTO_US 60000000       // upper bound of the timeout
+
+/**
+ * @brief Structure holding the RTT estimate of a connection
+ */
+typedef struct rtt_estimator {
+  long srtt_us;   // smoothed round trip time
+  long rttvar_us; // round trip time variation
+  long rto_us;    // current retransmission timeout
+  int has_sample; // 1 once the first RTT sample has been taken
+} rtt_estimator_t;
+
+/**
+ * @brief Initialize an RTT estimator
+ *
+ * Initialize an RTT estimator without samples, using INITIAL_RTO_US as the
+ * timeout.
+ *
+ * @param rtt The RTT estimator
+ */
+void init_rtt_estimator(rtt_estimator_t *rtt);
+
+/**
+ * @brief Add an RTT sample
+ *
+ * Update the smoothed RTT and RTT variation with a new sample and recompute
+ * the retransmission timeout, which also undoes any backoff.
+ *
+ * @param rtt The RTT estimator
+ * @param sample_us The measured round trip time in microseconds
+ */
+void update_rtt_estimator(rtt_estimator_t *rtt, long sample_us);
+
+/**
+ * @brief Back the retransmission timeout off
+ *
+ * Double the retransmission timeout after it expired, up to MAX_RTO_US.
+ *
+ * @param rtt The RTT estimator
+ */
+void backoff_rto(rtt_estimator_t *rtt);
+
+/**
+ * @brief Measure an RTT from an echoed timestamp
+ *
+ * Compute the time elapsed since the timestamp that the peer echoed back. The
+ * timestamp belongs to the transmission that the peer answered, so samples
+ * stay valid for retransmitted segments.
+ *
+ * @param ts_ecr The echoed timestamp, 0 if the peer did not echo one
+ * @return long the RTT sample in microseconds, -1 if there is no valid sample
+ */
+long rtt_sample_from_echo(uint32_t ts_ecr);
+
+#endif // RTT_ESTIMATOR_H
@@ -7,17 +7,68 @@
  * @brief Function prototypes for the sender
  *
  * This header file contains the function prototypes for sending a file to a
- * receiver, sending packets to the receiver and receiving ACKs, establishing a
- * connection with the receiver, and closing the connection with the receiver.
+ * receiver, sending packets to the receiver and receiving ACKs from an event
+ * loop, establishing a connection with the receiver, and closing the
+ * connection with the receiver.
  *
  * @author Ritam Singal (ritamsingal)
  * @author Harshil Patel (harshil-patel11)
  * @bug No known bugs
  */
 
+#include <pthread.h>
+#include <stdio.h>
+
+#include "congestion_control.h"
+#include "event_loop.h"
+#include "file_digest.h"
+#include "rtt_estimator.h"
+#include "tcp_io.h"
 #include "tcp_segment.h"
 #include "tcp_utils.h"
 
+#define DEFAULT_MAX_WINDOW 8192 // largest window in segments
+#define MAX_STREAMS 64          // streams of a striped transfer
+#define STRIPE_ALIGNMENT 65536  // stripes start at multiples of this offset
+// duplicate ACKs, or segments acknowledged past a hole, that mark it lost
+#define DUPACK_THRESHOLD 3
+#define PACING_BURST_US 250 // time an idle paced sender may catch up on
+#define PACING_SS_GAIN 2.0  // window paced per RTT in slow start
+#define PACING_CA_GAIN 1.2  // window paced per RTT in congestion avoidance
+
+/**
+ * @brief Enum representing how the sender recovers lost segments
+ */
+typedef enum retransmit_mode {
+  SELECTIVE_REPEAT = 0, // resend only the segments the receiver is missing
+  GO_BACK_N = 1         // resend every segment sent after a lost one
+} retransmit_mode_t;
+
+/**
+ * @brief Structure holding the options of a transfer
+ */
+typedef struct sender_options {
+  retransmit_mode_t retransmit_mode;
+  cc_algorithm_t cc_algorithm;
+  checksum_type_t checksum_type;
+  uint32_t max_window;   // largest number of segments in flight
+  uint16_t segment_size; // largest payload proposed to the receiver
+  int probe_path_mtu;    // 1 to derive segment_size from the path MTU
+  int offload;           // 1 to send trains of segments with UDP GSO
+  int map_file;          // 1 to send straight from a memory map of the file
+  io_engine_t io_engine; // system calls the segments are moved with
+  uint16_t num_streams;  // connections the file is striped over
+  char *cookie_file;     // file of fast open cookies, or NULL to not use them
+  uint64_t max_rate;     // bytes per second all streams may send, 0 for any
+} sender_options_t;
+
+/**
+ * @brief Initialize sender options to their defaults
+ *
+ * @param options The options to initialize
+ */
+void init_sender_options(sender_options_t *options);
+
 /**
  * @brief Send a file to a receiver
  *
@@ -35,63 +86,690 @@ void rsend(char *hostname, unsigned short int hostUDPport, char *filename,
            unsigned long long int bytesToTransfer);
 
 /**
- * @brief send packets to the receiver and receive ACKs
+ * @brief Send a file to a receiver with the given options
+ *
+ * Same as rsend(), but the transfer is configured by options instead of the
+ * defaults.
+ *
+ * @param hostname The hostname of the receiver
+ * @param host_udp_port The UDP port of the receiver
+ * @param filename The name of the file to send
+ * @param bytesToTransfer The number of bytes to send
+ * @param options The options of the transfer
+ * @return int SUCCESS if every stream was sent, or the error that failed the
+ * transfer
+ */
+int rsend_with_options(char *hostname, unsigned short int hostUDPport,
+                       char *filename, unsigned long long int bytesToTransfer,
+                       sender_options_t *options);
+
+/**
+ * @brief Structure holding one stream of a transfer
+ *
+ * A striped transfer splits the file into byte ranges and sends each of them
+ * from its own thread over its own socket and connection. The receiver puts
+ * the ranges back together by the offsets carried in the SYNs.
+ */
+typedef struct sender_stream {
+  struct sockaddr_in server_addr; // address of the receiver
+  char *filename;
+  unsigned long long int num_bytes; // bytes of the range the stream sends
+  // offset of the range and the transfer it belongs to, num_streams is 0 if
+  // the transfer is not striped
+  syn_options_t stripe;
+  sender_options_t *options;
+  pthread_t thread; // thread running the stream
+  int retval;       // SUCCESS once the stream was sent, or its error
+} sender_stream_t;
+
+/**
+ * @brief send one stream of a transfer on the calling thread
+ *
+ * Connect to the receiver, send the range of the file from an event loop, and
+ * close the connection.
+ *
+ * @param stream The stream
+ * @return int SUCCESS if successful, or the error that failed the stream
+ */
+int send_stream(sender_stream_t *stream);
+
+/**
+ * @brief thread entry point of a stream of a striped transfer
+ *
+ * @param arg The stream, its retval is set to the result of send_stream()
+ * @return void* NULL
+ */
+void *sender_worker(void *arg);
+
+/**
+ * @brief Structure tracking one segment within the send window
+ */
+typedef struct send_slot {
+  uint64_t deadline_us; // time at which the segment is retransmitted
+  int acked;            // 1 once the receiver has acknowledged the segment
+} send_slot_t;
+
+/**
+ * @brief Structure representing one transmission waiting for its deadline
+ */
+typedef struct retransmit_entry {
+  uint32_t seq_number;
+  uint64_t deadline_us;
+} retransmit_entry_t;
+
+/**
+ * @brief Structure representing the sender's sliding window
+ *
+ * Segments in [base, next) are in flight. The state of each of them is kept in
+ * slots[seq_number % max_window], so every in-flight segment has its own
+ * retransmit deadline. Transmissions are also queued in the order they were
+ * sent, which is the order of their deadlines, so the earliest deadline is
+ * found without scanning the window. Queue entries of segments that were
+ * acknowledged or sent again since are skipped. The payload of every segment
+ * is added to the digest of the file when it is sent the first time.
+ *
+ * A segment is lost once DUPACK_THRESHOLD duplicate ACKs arrived for it, or
+ * once segments DUPACK_THRESHOLD places past it were acknowledged while it
+ * was not. Lost segments are resent once without waiting for their deadline,
+ * and the segments acknowledged above base do not count against the
+ * congestion window, so new segments keep flowing during the recovery.
+ *
+ * Every transmission moves release_us on by one segment at the pacing rate,
+ * and new and resent segments alike are held back until release_us. The timer of the transfer
+ * then fires at release_us, so the window goes out spread over the round
+ * trip instead of in one burst.
+ *
+ * When a deadline passes, every segment in flight is lost. The timeout is
+ * taken once for all of them, however far apart their deadlines are, and they
+ * are resent from base on with at most the congestion window of them in
+ * flight, so the ACKs of the first ones clock out the rest.
+ *
+ * A receiver whose buffer is full closes its window, and opens it again with
+ * an ACK once the buffer drained. While the window is closed and nothing is
+ * in flight, a probe is sent at persist_us, backing off like a retransmit, so
+ * the transfer does not hang if that ACK is lost.
+ */
+typedef struct send_window {
+  uint32_t base;               // lowest unacknowledged sequence number
+  uint32_t next;               // next sequence number to be sent the first time
+  uint32_t recovery_seq;       // losses below this are part of the last loss
+  uint32_t sacked_end;         // one past the highest acknowledged segment
+  uint32_t lost_end;           // unacknowledged segments below this are lost
+  uint32_t retransmit_next;    // lost segments below this were resent
+  uint32_t num_sacked;         // acknowledged segments above base
+  uint32_t dup_acks;           // ACKs in a row that acknowledged nothing new
+  int timeout_recovery;        // 1 until the segments lost in it are acked
+  uint32_t timeout_pipe;       // segments resent since, still in flight
+  uint32_t receive_window_end; // the receiver accepts segments below this
+  uint32_t receiver_isn;       // echoed by every data segment
+  retransmit_mode_t retransmit_mode;
+  checksum_type_t checksum_type;
+  rtt_estimator_t *rtt;      // RTT estimate that sets the retransmit deadlines
+  congestion_control_t *cc;  // congestion control that sets the window size
+  tcp_io_t *io;              // batch segments are queued in and ACKs read into
+  send_slot_t *slots;        // max_window slots
+  uint32_t max_window;       // largest number of segments in flight
+  retransmit_entry_t *queue; // ring of queue_size transmissions
+  uint32_t queue_size;
+  uint32_t queue_head;  // index of the oldest transmission
+  uint32_t queue_tail;  // index after the newest transmission
+  xxh64_state_t digest; // digest of the segments below next
+  uint64_t num_sent;    // transmissions, retransmissions included
+  double max_rate;      // cap on the pacing rate in segments per second, or 0
+  uint64_t release_us;  // time the pacer lets the next segment go
+  int paced;            // 1 if the pacer held back a segment the windows allow
+  uint64_t persist_us;  // time the next window probe is sent, or 0
+  uint32_t num_probes;  // window probes sent since the window closed
+} send_window_t;
+
+/**
+ * @brief Structure holding the part of the file that is currently being sent
+ *
+ * A mapped buffer holds the whole file from the start and is never refilled.
+ * The buffer of a byte stream is filled by the application instead of a file.
+ * A stream may end a segment before it is full, so its segments keep their
+ * length, and each still takes segment_size bytes of data. Only full segments
+ * are sent before the end of the data, as more bytes may follow. Every
+ * buffer is a ring: segment seq_number takes slot seq_number % num_segments,
+ * so acknowledged slots are reused without moving any data.
+ */
+typedef struct send_buffer {
+  char *data;             // num_segments * segment_size bytes
+  uint16_t *segment_lens; // payload bytes of each segment of a stream, or NULL
+  uint32_t num_segments;  // capacity of the buffer in segments
+  uint16_t segment_size;  // payload bytes of every segment but the last
+  uint32_t base_seq;      // sequence number of the first buffered segment
+  size_t num_bytes;       // number of valid bytes from segment base_seq on
+  int eof;                // 1 once no more bytes will be read from the file
+  int mapped;             // 1 if data is a memory map of the file
+} send_buffer_t;
+
+/**
+ * @brief Structure holding the state of a transfer driven by an event loop
+ *
+ * The loop calls handle_sender_socket() when ACKs arrive and
+ * handle_retransmit_timer() when the earliest retransmit deadline or the
+ * release time of a paced segment passes. A byte stream has no file, its
+ * buffer is filled by append_send_buffer().
+ */
+typedef struct sender_state {
+  int socket_desc;
+  unsigned short int host_udp_port;  // UDP port of the receiver
+  in_port_t client_port;             // port of the sender
+  struct sockaddr_in *server_addr;   // address of the receiver
+  FILE *file;                        // file refilling the buffer, or NULL
+  unsigned long long int bytes_left; // bytes not read from the file yet
+  send_window_t *window;
+  send_buffer_t *buffer;
+  event_source_t socket_source;    // readiness of the socket
+  event_source_t retransmit_timer; // earliest retransmit or release time
+  uint64_t timer_deadline_us;      // deadline the timer is armed for, or 0
+} sender_state_t;
+
+/**
+ * @brief Set up the send buffer and window of a stream
+ *
+ * A buffer and window set up before are freed first and the file is rewound
+ * to the start of the range, so the stream starts over. This lets a sender
+ * whose first window was sent with a rejected fast open cookie, or with a
+ * segment size the receiver did not accept, send it again.
+ *
+ * @param state The state of the stream, its file, window and buffer are set up
+ * @param stream The stream
+ * @param segment_size The negotiated payload size of a segment
+ * @param checksum_type The checksum of the data segments
+ * @param rtt The RTT estimate of the connection
+ * @param cc The congestion control of the connection
+ * @param io The batch the segments are sent with
+ * @return int 0 if successful, -1 otherwise
+ */
+int start_send_transfer(sender_state_t *state, sender_stream_t *stream,
+                        uint16_t segment_size, checksum_type_t checksum_type,
+                        rtt_estimator_t *rtt, congestion_control_t *cc,
+                        tcp_io_t *io);
+
+/**
+ * @brief Allocate a send window
  *
- * Send packets to the receiver and receive ACKs from the receiver for those
- * packets. Ensures reliable data transfer of the packets. The function returns
- * the number of packets sent successfully based on the Go-back-n calculation on
- * unsuccessful packet delivery.
+ * @param window The send window
+ * @param max_window The largest number of segments in flight
+ * @return int 0 if successful, -1 if the window could not be allocated
+ */
+int init_send_window(send_window_t *window, uint32_t max_window);
+
+/**
+ * @brief Free the memory of a send window
+ *
+ * @param window The send window
+ */
+void free_send_window(send_window_t *window);
+
+/**
+ * @brief Allocate a send buffer
+ *
+ * @param buffer The send buffer
+ * @param num_segments The number of segments the buffer holds
+ * @param segment_size The negotiated payload size of a segment
+ * @return int 0 if successful, -1 if the buffer could not be allocated
+ */
+int init_send_buffer(send_buffer_t *buffer, uint32_t num_segments,
+                     uint16_t segment_size);
+
+/**
+ * @brief Allocate the send buffer of a byte stream
+ *
+ * @param buffer The send buffer
+ * @param num_segments The number of segments the buffer holds
+ * @param segment_size The negotiated payload size of a segment
+ * @return int 0 if successful, -1 if the buffer could not be allocated
+ */
+int init_stream_buffer(send_buffer_t *buffer, uint32_t num_segments,
+                       uint16_t segment_size);
+
+/**
+ * @brief Map a file into a send buffer
+ *
+ * Map num_bytes bytes of the file from the given offset, so segments are sent
+ * straight from the page cache instead of being read into an allocated
+ * buffer.
+ *
+ * @param buffer The send buffer
+ * @param file The file being sent
+ * @param offset The offset of the first byte to send, a multiple of the page
+ * size
+ * @param num_bytes The number of bytes to send
+ * @param segment_size The negotiated payload size of a segment
+ * @return int 0 if successful, -1 if the file could not be mapped
+ */
+int map_send_buffer(send_buffer_t *buffer, FILE *file,
+                    unsigned long long int offset,
+                    unsigned long long int num_bytes, uint16_t segment_size);
+
+/**
+ * @brief Free the memory of a send buffer
+ *
+ * @param buffer The send buffer
+ */
+void free_send_buffer(send_buffer_t *buffer);
+
+/**
+ * @brief refill the send buffer from the file
+ *
+ * Drop the segments below the window base from the send buffer and read more
+ * bytes from the file into the slots that are freed. Nothing is read while
+ * the buffer still has plenty of unsent segments.
+ *
+ * @param buffer The send buffer
+ * @param file The file being sent
+ * @param window_base The lowest unacknowledged sequence number
+ * @param window_next The next sequence number to be sent
+ * @param bytes_left The number of bytes that still have to be read from the
+ * file. Updated with the number of bytes read.
+ */
+void refill_send_buffer(send_buffer_t *buffer, FILE *file,
+                        uint32_t window_base, uint32_t window_next,
+                        unsigned long long int *bytes_left);
+
+/**
+ * @brief append bytes of a byte stream to the send buffer
+ *
+ * Drop the segments below the window base from the send buffer, and copy as
+ * many bytes as fit after the buffered ones into the free slots.
+ *
+ * @param buffer The send buffer of the stream
+ * @param window_base The lowest unacknowledged sequence number
+ * @param data The bytes to append
+ * @param len Number of bytes to append
+ * @return size_t number of bytes appended, 0 if the buffer is full
+ */
+size_t append_send_buffer(send_buffer_t *buffer, uint32_t window_base,
+                          const char *data, size_t len);
+
+/**
+ * @brief end the last segment of a byte stream
+ *
+ * End the segment holding the last appended bytes even if it is not full, so
+ * that it is sent without waiting for more bytes.
+ *
+ * @param buffer The send buffer of the stream
+ */
+void seal_send_buffer(send_buffer_t *buffer);
+
+/**
+ * @brief get the sequence number one past the last segment in the buffer
+ *
+ * A segment that is not full is only counted once no more bytes follow it.
+ *
+ * @param buffer The send buffer
+ * @return uint32_t sequence number following the last segment ready to send
+ */
+uint32_t send_buffer_end(send_buffer_t *buffer);
+
+/**
+ * @brief get the payload length of a buffered segment
+ *
+ * @param buffer The send buffer
+ * @param seq_number The sequence number of the segment, within the buffer
+ * @return uint16_t payload bytes of the segment
+ */
+uint16_t send_segment_len(send_buffer_t *buffer, uint32_t seq_number);
+
+/**
+ * @brief get the payload of a buffered segment
+ *
+ * @param buffer The send buffer
+ * @param seq_number The sequence number of the segment, within the buffer
+ * @return char* first byte of the payload of the segment
+ */
+char *send_segment_data(send_buffer_t *buffer, uint32_t seq_number);
+
+/**
+ * @brief send the segment with the given sequence number
+ *
+ * Send one data segment read from the send buffer and arm its retransmit
+ * deadline.
+ *
+ * @param host_udp_port The UDP port of the receiver
+ * @param client_port The port of the sender
+ * @param server_addr The address of the receiver
+ * @param window The send window
+ * @param buffer The send buffer holding the segment's data
+ * @param seq_number The sequence number of the segment to send
+ * @return tcp_error_t
+ */
+tcp_error_t send_data_segment(unsigned short int host_udp_port,
+                              in_port_t client_port,
+                              struct sockaddr_in *server_addr,
+                              send_window_t *window, send_buffer_t *buffer,
+                              uint32_t seq_number);
+
+/**
+ * @brief check whether a queued transmission still needs its deadline
+ *
+ * @param window The send window
+ * @param entry The queued transmission
+ * @return int 1 if the segment is in flight, unacknowledged and was not sent
+ * again after this transmission, 0 otherwise
+ */
+int is_retransmit_entry_live(send_window_t *window, retransmit_entry_t *entry);
+
+/**
+ * @brief queue a transmission
+ *
+ * @param window The send window
+ * @param seq_number The sequence number of the segment that was sent
+ * @param deadline_us The retransmit deadline of the transmission
+ */
+void push_retransmit_entry(send_window_t *window, uint32_t seq_number,
+                           uint64_t deadline_us);
+
+/**
+ * @brief get the transmission with the earliest deadline
+ *
+ * Drop the queued transmissions that no longer need a deadline from the head
+ * of the queue and return the first one that does.
+ *
+ * @param window The send window
+ * @return retransmit_entry_t* the transmission, NULL if nothing is in flight
+ */
+retransmit_entry_t *next_retransmit_entry(send_window_t *window);
+
+/**
+ * @brief send new segments until the window is full
+ *
+ * Send segments that have not been sent before for as long as the congestion
+ * window and the receiver's advertised window have room for them and the send
+ * buffer has data for them. Segments the receiver already acknowledged above
+ * base do not take room in the congestion window. The pacer stops the
+ * segments whose release time has not come yet, and sets paced.
+ *
+ * @param host_udp_port The UDP port of the receiver
+ * @param client_port The port of the sender
+ * @param server_addr The address of the receiver
+ * @param window The send window
+ * @param buffer The send buffer
+ * @return tcp_error_t
+ */
+tcp_error_t send_new_segments(unsigned short int host_udp_port,
+                              in_port_t client_port,
+                              struct sockaddr_in *server_addr,
+                              send_window_t *window, send_buffer_t *buffer);
+
+/**
+ * @brief Get the rate the segments of a window are paced at
+ *
+ * The rate is the one the congestion control asks for. Algorithms that only
+ * keep a window spread it over the smoothed RTT, with PACING_SS_GAIN in slow
+ * start and PACING_CA_GAIN afterwards, once an RTT was measured. The rate
+ * never exceeds the cap of the operator.
+ *
+ * @param window The send window
+ * @return double the rate in segments per second, 0 if the segments are not
+ * paced
+ */
+double sender_pacing_rate(send_window_t *window);
+
+/**
+ * @brief Account a transmission to the pacer
+ *
+ * Move the release time of the next segment on by one segment at the pacing
+ * rate. A release time more than PACING_BURST_US in the past is moved up
+ * first, so a sender that was idle does not send an unbounded burst.
+ *
+ * @param window The send window
+ * @param now_us The time of the transmission
+ */
+void pace_transmission(send_window_t *window, uint64_t now_us);
+
+/**
+ * @brief mark a range of segments as acknowledged
+ *
+ * Mark the in-flight segments in [start, end) as acknowledged. Sequence
+ * numbers outside the window are ignored.
+ *
+ * @param window The send window
+ * @param start The first sequence number of the range
+ * @param end One past the last sequence number of the range
+ * @return int number of segments that were not acknowledged before
+ */
+int mark_segments_acked(send_window_t *window, uint32_t start, uint32_t end);
+
+/**
+ * @brief process one ACK and slide the window
+ *
+ * The cumulative ACK number and the SACK blocks of an ACK mark segments as
+ * acknowledged, and the left edge of the window moves past every acknowledged
+ * segment. The window advertised by the receiver is recorded. The timestamp
+ * echoed by an ACK that acknowledges new segments is used as an RTT sample,
+ * and the newly acknowledged segments are reported to the congestion control.
+ * Duplicate ACKs and the highest acknowledged segment move lost_end, which
+ * retransmit_lost_segments() resends up to.
+ *
+ * @param window The send window
+ * @param ack_segment The received ACK
+ */
+void process_ack(send_window_t *window, tcp_segment_t *ack_segment);
+
+/**
+ * @brief read the ACKs that have arrived and slide the window
+ *
+ * Receive one batch without waiting and process every ACK in it with
+ * process_ack().
+ *
+ * @param window The send window
+ * @return SUCCESS if the ACKs that arrived were processed, CONNECTION_RESET if
+ * the receiver reset the connection, RECV_FAILED or UNKNOWN_FAILURE if they
+ * could not be received
+ */
+tcp_error_t recv_ack(send_window_t *window);
+
+/**
+ * @brief move a transfer forward
+ *
+ * Refill the send buffer, take a timeout if a deadline has passed, resend the
+ * lost segments, send the new segments the window allows, probe a closed
+ * receive window, and arm the retransmit timer for the earliest deadline that
+ * is left, the release time of the next segment if the pacer held it back, or
+ * the time of the next window probe.
+ *
+ * @param state The transfer
+ * @return int EVENT_CONTINUE while the transfer goes on, EVENT_STOP once every
+ * byte is acknowledged, or the error of sending
+ */
+int advance_sender(sender_state_t *state);
+
+/**
+ * @brief event loop handler for ACKs arriving on the socket
+ *
+ * @param context The transfer
+ * @param events The ready epoll events
+ * @return int the result of advance_sender(), or the error of recv_ack()
+ */
+int handle_sender_socket(void *context, uint32_t events);
+
+/**
+ * @brief event loop handler for the retransmit timer
+ *
+ * @param context The transfer
+ * @param events The ready epoll events
+ * @return int the result of advance_sender()
+ */
+int handle_retransmit_timer(void *context, uint32_t events);
+
+/**
+ * @brief retransmit segments that were detected as lost
+ *
+ * Resend the unacknowledged segments below lost_end that were not resent
+ * since they were detected as lost, without waiting for their deadline. With
+ * GO_BACK_N every segment sent after the first of them is resent too. The
+ * congestion control is told about the loss once per loss event, so the
+ * window shrinks once and new segments keep flowing while the holes are
+ * repaired. After a timeout the segments are resent one at a time, with at
+ * most the congestion window of them in flight. The pacer stops the segments
+ * whose release time has not come yet, and sets paced; they are resent from
+ * retransmit_next once it has.
+ *
+ * @param host_udp_port The UDP port of the receiver
+ * @param client_port The port of the sender
+ * @param server_addr The address of the receiver
+ * @param window The send window
+ * @param buffer The send buffer
+ * @return tcp_error_t
+ */
+tcp_error_t retransmit_lost_segments(unsigned short int host_udp_port,
+                                     in_port_t client_port,
+                                     struct sockaddr_in *server_addr,
+                                     send_window_t *window,
+                                     send_buffer_t *buffer);
+
+/**
+ * @brief take a timeout for the segments whose deadline has passed
+ *
+ * The first expired deadline of a segment sent after the last timeout, or of
+ * any segment outside of a timeout recovery, starts a new timeout: the
+ * retransmission timeout is backed off, the congestion control is told about
+ * the timeout, and every segment in flight is marked lost for
+ * retransmit_lost_segments(), whether or not a recovery was in progress. The
+ * deadlines of the segments that were not resent since are dropped.
+ *
+ * @param window The send window
+ */
+void mark_expired_segments_lost(send_window_t *window);
+
+/**
+ * @brief ask a receiver with a closed window for its window
+ *
+ * Send a segment without payload that repeats the sequence number below base,
+ * which the receiver already has and answers with an ACK carrying its current
+ * window.
  *
  * @param socket_desc The socket descriptor
  * @param host_udp_port The UDP port of the receiver
  * @param client_port The port of the sender
  * @param server_addr The address of the receiver
- * @param seq_number The sequence number base value of the packets to send
- * @param buffer The buffer containing the dat to send
- * @param bytes_in_buffer The number of bytes in the buffer that are to be sent
- * @param window_size The window size of the TCP connection
- * @param retval A pointer where the function stores the return value. The
- * return value is the number of packets sent successfully
+ * @param window The send window
  * @return tcp_error_t
  */
-tcp_error_t
-send_and_recv_packets(int socket_desc, unsigned short int host_udp_port,
-                      in_port_t client_port, struct sockaddr_in *server_addr,
-                      uint32_t seq_number, char *buffer, size_t bytes_in_buffer,
-                      int window_size, int *retval);
+tcp_error_t send_window_probe(int socket_desc, unsigned short int host_udp_port,
+                              in_port_t client_port,
+                              struct sockaddr_in *server_addr,
+                              send_window_t *window);
 
 /**
  * @brief establish a connection with the receiver
  *
  * Establish a reliable connection with the receiver in order to transfer data.
+ * The SYN proposes a segment size and the SYN-ACK answers with the largest
+ * size the receiver accepts; the connection uses the smaller of the two. The
+ * proposed checksum is used for the data segments only if the receiver
+ * accepts it, the internet checksum otherwise. The SYN of a stream of a
+ * striped transfer also carries its stripe fields.
+ *
+ * The SYN-ACK carries the initial sequence number of the receiver, which the
+ * data segments echo in their ACK number to prove the sender is at its
+ * address. With fast open, the SYN carries the cookie the receiver issued to
+ * a previous connection, or asks for one, and the first window is sent right
+ * behind the first SYN; the receiver takes it without the echo if the cookie
+ * is valid.
  *
  * @param client_port The port of the sender
  * @param server_port The port of the receiver
  * @param socket_desc The socket descriptor
  * @param server_addr The address of the receiver
  * @param client_addr The address of the sender
+ * @param rtt The RTT estimate that sets the time to wait for the SYN-ACK
+ * @param receive_window Pointer where the end of the window advertised by
+ * the receiver is stored
+ * @param receiver_isn Pointer where the initial sequence number of the
+ * receiver is stored
+ * @param syn_options The options of the SYN, with the proposed segment size,
+ * checksum and cookie, where the negotiated ones and the cookie issued by the
+ * receiver are stored; fast_open is cleared if the receiver issued none
+ * @param first_window The stream whose first window is sent behind the SYN,
+ * or NULL
  * @return tcp_error_t
  */
 tcp_error_t establish_connection_sender(int client_port, int server_port,
                                         int socket_desc,
                                         struct sockaddr_in *server_addr,
-                                        struct sockaddr_in *client_addr);
+                                        struct sockaddr_in *client_addr,
+                                        rtt_estimator_t *rtt,
+                                        uint32_t *receive_window,
+                                        uint32_t *receiver_isn,
+                                        syn_options_t *syn_options,
+                                        sender_state_t *first_window);
 
 /**
  * @brief close the connection with the receiver
  *
- * Close the connection with the receiver.
+ * Close the connection with the receiver. The FIN carries the digest of the
+ * file, and the receiver answers with a RST instead of a FIN-ACK if the file
+ * it received has another digest. The reason carried by the RST tells that
+ * apart from a receiver that could not write the file, or that was closed
+ * before the FIN. A rate limited receiver that still writes held data
+ * acknowledges the FIN and sends the FIN-ACK once the file is written, so
+ * the sender waits for as long as the FIN keeps being acknowledged.
  *
  * @param client_port The port of the sender
  * @param server_port The port of the receiver
  * @param socket_desc The socket descriptor
  * @param server_addr The address of the receiver
  * @param client_addr The address of the sender
- * @return tcp_error_t
+ * @param rtt The RTT estimate that sets the time to wait for the FIN-ACK
+ * @param fin_seq The sequence number of the FIN, one past the last segment
+ * @param digest The digest of the data segments sent
+ * @return tcp_error_t SUCCESS if the receiver confirmed the file,
+ * DIGEST_MISMATCH if it rejected the file, WRITE_FAILED if it could not write
+ * it, CONNECTION_RESET if it reset the connection for another reason, TIMEOUT
+ * if 10 FINs in a row were not answered, or the error of send_tcp() or
+ * wait_for_fin_ack()
  */
 tcp_error_t close_connection_sender(int client_port, int server_port,
                                     int socket_desc,
                                     struct sockaddr_in *server_addr,
-                                    struct sockaddr_in *client_addr);
+                                    struct sockaddr_in *client_addr,
+                                    rtt_estimator_t *rtt, uint32_t fin_seq,
+                                    uint64_t digest);
+
+/**
+ * @brief wait for the answer to a FIN
+ *
+ * Wait up to the retransmission timeout for the FIN-ACK, ignoring any other
+ * segment but a RST and the ACK of the FIN itself. The answer's echoed
+ * timestamp is used as an RTT sample, and the timeout is backed off if it
+ * expires.
+ *
+ * @param socket_desc The socket descriptor
+ * @param client_addr The address the segment is received from
+ * @param fin_seq The sequence number of the FIN
+ * @param rtt The RTT estimate
+ * @param recv_segment Pointer where the segment is stored
+ * @return SUCCESS if the FIN-ACK arrived, WOULD_BLOCK if only the ACK of the
+ * FIN did, TIMEOUT if neither did, CONNECTION_RESET if a RST arrived, or the
+ * error of recv_tcp_with_timeout()
+ */
+tcp_error_t wait_for_fin_ack(int socket_desc, struct sockaddr_in *client_addr,
+                             uint32_t fin_seq, rtt_estimator_t *rtt,
+                             tcp_segment_t *recv_segment);
+
+/**
+ * @brief wait for a segment with the given flags
+ *
+ * Wait up to the retransmission timeout for a segment carrying exactly the
+ * given flags, ignoring any other segment but a RST. The answer's echoed
+ * timestamp is used as an RTT sample, and the timeout is backed off if it
+ * expires.
+ *
+ * @param socket_desc The socket descriptor
+ * @param client_addr The address the segment is received from
+ * @param flags The flags of the expected segment
+ * @param rtt The RTT estimate
+ * @param recv_segment Pointer where the segment is stored
+ * @return SUCCESS if the segment arrived, TIMEOUT if it did not,
+ * CONNECTION_RESET if a RST arrived, or the error of recv_tcp_with_timeout()
+ */
+tcp_error_t wait_for_flags(int socket_desc, struct sockaddr_in *client_addr,
+                           uint8_t flags, rtt_estimator_t *rtt,
+                           tcp_segment_t *recv_segment);
 
 #endif
\ No newline at end of file
@@ -0,0 +1,174 @@
+#ifndef SESSION_H
+#define SESSION_H
+
+/**
+ * @file session.h
+ *
+ * @brief Function prototypes for sessions that carry many files
+ *
+ * This header file contains the function prototypes for sending many files
+ * over one connection and for receiving them into a directory. A session is
+ * a connection of libtcpudp whose byte stream holds the files one after the
+ * other, each preceded by a header with its size, mode and name, so the
+ * handshakes are paid once per session instead of once per file.
+ *
+ * @author Ritam Singal (ritamsingal)
+ * @author Harshil Patel (harshil-patel11)
+ * @bug No known bugs
+ */
+
+#include <stdint.h>
+
+#include "receiver.h"
+#include "sender.h"
+#include "tcpudp.h"
+
+#define SESSION_HEADER_SIZE 14   // size, mode and name length of a file
+#define MAX_SESSION_NAME 255     // longest name of a file in a session
+#define SESSION_CHUNK_SIZE 65536 // bytes moved per send or receive call
+
+/**
+ * @brief Structure holding the header that precedes a file in a session
+ *
+ * On the wire the header is the size, mode and name length in network byte
+ * order, followed by the name without a terminating NUL.
+ */
+typedef struct session_file_header {
+  uint64_t size;                   // bytes of the file after the header
+  uint32_t mode;                   // permission bits of the file
+  uint16_t name_len;               // bytes of the name after the header
+  char name[MAX_SESSION_NAME + 1]; // name of the file, without a directory
+} session_file_header_t;
+
+/**
+ * @brief Structure holding the receiving end of a session
+ */
+typedef struct session_receiver {
+  tcpudp_conn_t *conn;
+  char *directory; // directory the files are written to
+  // header being received, while no file is open
+  unsigned char header[SESSION_HEADER_SIZE + MAX_SESSION_NAME];
+  size_t header_len;          // bytes of the header received so far
+  session_file_header_t file; // header of the file being written
+  int file_desc;              // file being written, or -1 between files
+  uint64_t bytes_left;        // bytes of the file not written yet
+  uint32_t num_files;         // files written completely
+} session_receiver_t;
+
+/**
+ * @brief Encode the header of a file
+ *
+ * @param header The header
+ * @param data The buffer to write the header to, with room for
+ * SESSION_HEADER_SIZE + MAX_SESSION_NAME bytes
+ * @return size_t number of bytes written
+ */
+size_t write_session_header(session_file_header_t *header,
+                            unsigned char *data);
+
+/**
+ * @brief Decode the size, mode and name length of a file
+ *
+ * @param data The first SESSION_HEADER_SIZE bytes of the header
+ * @param header The header to fill, except for the name
+ * @return int 0 if successful, -1 if the name length is not valid
+ */
+int read_session_header(const unsigned char *data,
+                        session_file_header_t *header);
+
+/**
+ * @brief Send files to a receiver over one session
+ *
+ * Files that cannot be opened or are not regular files are skipped. A file
+ * that cannot be read after its header was sent ends the session.
+ *
+ * @param hostname The hostname of the receiver
+ * @param port The UDP port of the receiver
+ * @param filenames The files to send, each named by its last path component
+ * @param num_files Number of files
+ * @param options The options of the sender
+ * @return int number of files sent, or -1 if the session failed
+ */
+int send_session(char *hostname, unsigned short int port, char **filenames,
+                 int num_files, sender_options_t *options);
+
+/**
+ * @brief Send one file of a session
+ *
+ * @param conn The connection of the session
+ * @param filename The file to send
+ * @param data A buffer of SESSION_CHUNK_SIZE bytes
+ * @return int 1 if the file was sent, 0 if it was skipped, or the error that
+ * broke the session
+ */
+int send_session_file(tcpudp_conn_t *conn, char *filename, char *data);
+
+/**
+ * @brief Send bytes on a session, waiting while the send buffer is full
+ *
+ * @param conn The connection of the session
+ * @param data The bytes
+ * @param len Number of bytes
+ * @return int SUCCESS, or the error that broke the session
+ */
+int send_session_bytes(tcpudp_conn_t *conn, const char *data, size_t len);
+
+/**
+ * @brief Receive sessions and write their files to a directory
+ *
+ * In server mode sessions are served until the process is stopped, up to
+ * options->max_connections at once. Otherwise the receiver stops after the
+ * first session.
+ *
+ * @param port The UDP port to bind
+ * @param directory The directory the files are written to
+ * @param options The options of the receiver
+ * @return int 0 if successful, -1 if the receiver could not run or its only
+ * session failed
+ */
+int receive_sessions(unsigned short int port, char *directory,
+                     receiver_options_t *options);
+
+/**
+ * @brief Read what arrived on a session and write it to its files
+ *
+ * @param session The session
+ * @param data A buffer of SESSION_CHUNK_SIZE bytes
+ * @return int EVENT_CONTINUE while the session is open, EVENT_STOP once the
+ * sender closed it after a whole file, or the error that broke it
+ */
+int receive_session_data(session_receiver_t *session, char *data);
+
+/**
+ * @brief Write bytes of a session to its files
+ *
+ * The bytes complete the header of the next file, which opens the file in
+ * the directory of the session, or are written to the open file.
+ *
+ * @param session The session
+ * @param data The bytes
+ * @param len Number of bytes
+ * @return int 0 if successful, -1 if a header is not valid or a file could
+ * not be written
+ */
+int write_session_data(session_receiver_t *session, const char *data,
+                       size_t len);
+
+/**
+ * @brief Open the file announced by the header of a session
+ *
+ * @param session The session
+ * @return int 0 if successful, -1 if the name is not valid or the file could
+ * not be opened
+ */
+int open_session_file(session_receiver_t *session);
+
+/**
+ * @brief Close the file of a session once it was written completely
+ *
+ * @param session The session
+ * @return int 0 if successful, -1 if the file could not be closed
+ */
+int close_session_file(session_receiver_t *session);
+
+#endif
@@ -0,0 +1,279 @@
+/**
+ * @file tcp_io.h
+ * @brief Function prototypes for sending and receiving TCP segments in batches
+ *
+ * This header file contains the function prototypes for queueing TCP segments
+ * and sending them with a single sendmmsg call, and for draining every
+ * segment waiting on a socket with a single recvmmsg call. On Linux the batch
+ * can also hand trains of equal-sized segments to the kernel as one UDP GSO
+ * buffer and take coalesced trains back with UDP GRO. With the io_uring engine
+ * the datagrams of a batch and the file writes of the receiver are submitted
+ * to an io_uring instance instead, and moved with one system call.
+ *
+ * @author Ritam Singal (ritamsingal)
+ * @author Harshil Patel (harshil-patel11)
+ * @bug No known bugs
+ */
+
+#ifndef TCP_IO_H
+#define TCP_IO_H
+
+#include <netinet/in.h>
+#include <stdint.h>
+#include <sys/types.h>
+
+#include "tcp_segment.h"
+#include "tcp_uring.h"
+#include "tcp_utils.h"
+
+#define IO_BATCH_SIZE 64       // datagrams moved by one system call
+#define GSO_MAX_SEGMENTS 64    // segments the kernel splits one buffer into
+#define GSO_MAX_MESSAGE 65507  // largest UDP payload over IPv4
+#define GSO_MESSAGE_SIZE 65536 // buffer of one message in offload mode
+
+/**
+ * @brief Enum representing the system calls a batch is moved with
+ */
+typedef enum io_engine {
+  IO_ENGINE_MMSG = 0, // sendmmsg, recvmmsg after poll, and pwrite
+  IO_ENGINE_URING = 1 // linked io_uring submissions for datagrams and writes
+} io_engine_t;
+
+/**
+ * @brief Structure holding the datagrams of one batch
+ *
+ * A batch is used in one direction at a time: segments are queued and then
+ * flushed, or datagrams are received and then read with next_tcp_segment().
+ * In offload mode one message holds a train of segments of gso_size bytes,
+ * of which only the last may be shorter. A queued segment is sent from two
+ * buffers, its encoded header and its payload, so a payload that outlives the
+ * batch is sent without being copied.
+ *
+ * With the io_uring engine, file writes are queued with the payload copied
+ * into a registered buffer and submitted along with the next batch.
+ */
+typedef struct tcp_io {
+  int socket_desc;
+  int capacity;              // messages in one batch
+  int num_queued;            // messages waiting to be sent
+  int num_received;          // messages received by the last recvmmsg
+  int offload;               // 1 if messages carry UDP GSO/GRO trains
+  int segments_per_message;  // largest number of segments in one message
+  size_t message_size;       // bytes of the buffer of one message
+  unsigned char *buffers;    // capacity message buffers
+  unsigned char *headers;    // encoded headers of the queued segments
+  char *control;             // capacity control buffers for the GSO size
+  struct mmsghdr *msgs;      // one message per datagram or train
+  struct iovec *iovecs;      // one received buffer per message
+  struct iovec *send_iovecs; // header and payload of each queued segment
+  struct sockaddr_in *addrs; // peer of each message
+  uint16_t *gso_sizes;       // segment size of each train, 0 if not a train
+  int *num_segments;         // segments in each queued message
+  size_t *message_lens;      // bytes in each queued message
+  int next_message;          // next received message to read from
+  size_t next_offset;        // offset of the next segment in that message
+  io_engine_t engine;        // system calls the batch is moved with
+  tcp_uring_t ring;          // io_uring instance of the io_uring engine
+  char *write_buffers;       // capacity registered payloads of file writes
+  size_t *write_lens;        // bytes of each queued file write
+  int num_writes;            // file writes prepared or in flight
+  int num_pending;           // submissions waiting for their completion
+  int timed_out;             // 1 if the last receive chain timed out
+  tcp_error_t uring_error;   // first failure among the last completions
+} tcp_io_t;
+
+/**
+ * @brief Allocate the batches of a socket
+ *
+ * Offload mode is only turned on if the kernel supports UDP GSO and GRO on
+ * the socket; io->offload tells whether it is on. Likewise the io_uring engine
+ * falls back to IO_ENGINE_MMSG if the kernel cannot set up a ring.
+ *
+ * @param io The batch
+ * @param socket_desc Socket descriptor
+ * @param capacity Number of messages in one batch
+ * @param offload 1 to send and receive trains of segments with UDP GSO/GRO
+ * @param engine The system calls the batch is moved with
+ * @return int 0 if successful, -1 if the batch could not be allocated
+ */
+int init_tcp_io(tcp_io_t *io, int socket_desc, int capacity, int offload,
+                io_engine_t engine);
+
+/**
+ * @brief Parse the name of an I/O engine
+ *
+ * @param name "mmsg" or "uring"
+ * @param engine Pointer where the engine is stored
+ * @return int 0 if successful, -1 if the name is unknown
+ */
+int parse_io_engine(const char *name, io_engine_t *engine);
+
+/**
+ * @brief Free the memory of a batch
+ *
+ * @param io The batch
+ */
+void free_tcp_io(tcp_io_t *io);
+
+/**
+ * @brief Find the message a segment is queued in
+ *
+ * In offload mode the segment joins the train of the last queued message if
+ * it goes to the same peer and is no longer than the segments of the train.
+ * Otherwise a new message is started, and the batch is flushed first if it is
+ * full.
+ *
+ * @param io The batch
+ * @param length Wire length of the segment
+ * @param server_addr Server address
+ * @return int index of the message, -1 if a full batch could not be sent
+ */
+int reserve_tcp_message(tcp_io_t *io, size_t length,
+                        struct sockaddr_in *server_addr);
+
+/**
+ * @brief Queue a TCP segment
+ *
+ * Encode the segment into the batch, copying its payload
+ *
+ * @param io The batch
+ * @param send_segment TCP segment to send
+ * @param server_addr Server address
+ * @return SUCCESS if successful, SEND_FAILED if a full batch could not be sent
+ */
+tcp_error_t queue_tcp(tcp_io_t *io, tcp_segment_t *send_segment,
+                      struct sockaddr_in *server_addr);
+
+/**
+ * @brief Queue a TCP segment whose payload is kept apart
+ *
+ * Encode the header of the segment into the batch and send the data_len bytes
+ * at payload after it without copying them. The payload has to stay valid and
+ * unchanged until the batch is flushed.
+ *
+ * @param io The batch
+ * @param send_segment TCP segment to send, without its payload
+ * @param payload Pointer to the payload, NULL to copy the data of the segment
+ * @param server_addr Server address
+ * @return SUCCESS if successful, SEND_FAILED if a full batch could not be sent
+ */
+tcp_error_t queue_tcp_payload(tcp_io_t *io, tcp_segment_t *send_segment,
+                              const char *payload,
+                              struct sockaddr_in *server_addr);
+
+/**
+ * @brief Check whether a segment can join the train of the last message
+ *
+ * @param io The batch
+ * @param length Wire length of the segment
+ * @param server_addr Server address of the segment
+ * @return int 1 if the segment can be appended, 0 otherwise
+ */
+int can_extend_train(tcp_io_t *io, size_t length,
+                     struct sockaddr_in *server_addr);
+
+/**
+ * @brief Send every queued TCP segment
+ *
+ * @param io The batch
+ * @return SUCCESS if successful, SEND_FAILED if failed to send from socket,
+ * WRITE_FAILED if a queued file write failed
+ */
+tcp_error_t flush_tcp(tcp_io_t *io);
+
+/**
+ * @brief Receive every datagram waiting on the socket
+ *
+ * Wait until a datagram arrives or the timeout expires, then receive as many
+ * datagrams as fit into the batch without waiting again. The segments are
+ * read with next_tcp_segment().
+ *
+ * @param io The batch
+ * @param timeout_us Maximum time to wait in microseconds, 0 to only take the
+ * datagrams that are queued already, negative to wait without a timeout
+ * @return int number of datagrams received if successful, TIMEOUT if timeout
+ * occurs, RECV_FAILED if failed to receive from socket, WRITE_FAILED if a
+ * queued file write failed, UNKNOWN_FAILURE if unknown failure
+ */
+int recv_tcp_batch(tcp_io_t *io, long timeout_us);
+
+/**
+ * @brief Send the queued segments with the io_uring engine
+ *
+ * One send entry is submitted per message, together with the queued file
+ * writes, and every completion is waited for.
+ *
+ * @param io The batch
+ * @return SUCCESS if successful, SEND_FAILED if failed to send from socket,
+ * WRITE_FAILED if a file write failed
+ */
+tcp_error_t send_tcp_uring(tcp_io_t *io);
+
+/**
+ * @brief Receive a batch with the io_uring engine
+ *
+ * Submit a chain of receives, one per message. The first one waits for a
+ * datagram, limited by a linked timeout, and the others do not wait, so the
+ * chain stops at the first receive that finds the socket empty.
+ *
+ * @param io The batch
+ * @param timeout_us Maximum time to wait in microseconds, negative to wait
+ * without a timeout
+ * @return int number of datagrams received if successful, TIMEOUT if timeout
+ * occurs, RECV_FAILED if failed to receive from socket, WRITE_FAILED if a file
+ * write failed, UNKNOWN_FAILURE if unknown failure
+ */
+int recv_tcp_uring(tcp_io_t *io, long timeout_us);
+
+/**
+ * @brief Submit the prepared io_uring entries and wait for all of them
+ *
+ * Handle every completion: record the length of each received datagram and
+ * whether the receive timeout fired, and remember the first failed send,
+ * receive or write in io->uring_error.
+ *
+ * @param io The batch
+ * @return SUCCESS if the entries were submitted, UNKNOWN_FAILURE otherwise
+ */
+tcp_error_t complete_tcp_uring(tcp_io_t *io);
+
+/**
+ * @brief Write received data to a file
+ *
+ * With IO_ENGINE_MMSG the data is written right away with pwrite. With the
+ * io_uring engine it is copied into a registered buffer and written by a
+ * fixed write submitted with the next batch, or once every buffer is in use.
+ *
+ * @param io The batch
+ * @param file_desc The file to write to
+ * @param data The data to write
+ * @param length Bytes of data, at most MAX_SEGMENT_DATA_SIZE
+ * @param offset Offset in the file to write at
+ * @return SUCCESS if successful, WRITE_FAILED if a write failed
+ */
+tcp_error_t write_tcp_file(tcp_io_t *io, int file_desc, const char *data,
+                           size_t length, off_t offset);
+
+/**
+ * @brief Wait until every queued file write is done
+ *
+ * @param io The batch
+ * @return SUCCESS if successful, WRITE_FAILED if a write failed
+ */
+tcp_error_t sync_tcp_writes(tcp_io_t *io);
+
+/**
+ * @brief Read the next received TCP segment
+ *
+ * Segments are read in the order they arrived, splitting coalesced GRO trains.
+ * Segments that are malformed or fail the checksum are skipped.
+ *
+ * @param io The batch
+ * @param recv_segment TCP segment to fill
+ * @param client_addr Pointer where the address of the peer is stored
+ * @return int 1 if a segment was read, 0 once every segment has been read
+ */
+int next_tcp_segment(tcp_io_t *io, tcp_segment_t *recv_segment,
+                     struct sockaddr_in *client_addr);
+
+#endif // TCP_IO_H
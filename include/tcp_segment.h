@@ -4,8 +4,8 @@
  * checksum of a TCP segment
  *
  * This header file contains the function prototypes for creating a TCP segment,
- * calculating the checksum of a TCP segment, and comparing the checksum of a
- * TCP segment
+ * calculating the checksum of a TCP segment, comparing the checksum of a TCP
+ * segment, and converting a TCP segment to and from its wire format
  *
  * @author Ritam Singal (ritamsingal)
  * @author Harshil Patel (harshil-patel11)
@@ -18,23 +18,122 @@
 #include <stdint.h>
 #include <stdlib.h>
 
-// maximum size of the data field within the segment
-#define SEGMENT_DATA_SIZE 512
+#include "checksum.h"
+
+// largest payload of a segment, filling a 9000 byte jumbo frame
+#define MAX_SEGMENT_DATA_SIZE 8936
+
+// smallest payload size a connection negotiates
+#define MIN_SEGMENT_DATA_SIZE 64
+
+// payload size proposed by default, filling a 1500 byte Ethernet frame
+#define DEFAULT_SEGMENT_DATA_SIZE 1436
+
+// maximum number of SACK blocks carried by an ACK
+#define MAX_SACK_BLOCKS 4
+
+/**
+ * @brief Structure representing a range of segments the receiver holds beyond
+ * the cumulative ACK
+ */
+typedef struct sack_block {
+  uint32_t start; // first sequence number in the block
+  uint32_t end;   // one past the last sequence number in the block
+} sack_block_t;
 
 /**
  * @brief Structure representing a TCP segment
+ *
+ * The fields are in host byte order. Only the first num_sack_blocks SACK
+ * blocks and the first data_len bytes of data are valid.
  */
 typedef struct tcp_segment {
   uint16_t source_port;
   uint16_t dest_port;
   uint32_t seq_number;
   uint32_t ack_number;
-  uint8_t head_len;
+  uint32_t window;  // segments the receiver accepts beyond ack_number
+  uint8_t head_len; // bytes of the wire header including the SACK blocks
   uint8_t flags;
-  uint16_t checksum;
-  char data[SEGMENT_DATA_SIZE];
+  uint32_t checksum;     // CRC32C, or the one's complement sum in 16 bits
+  uint8_t checksum_type; // checksum_type_t the segment is protected with
+  uint32_t ts_val;       // time at which the segment was sent
+  uint32_t ts_ecr;       // ts_val of the segment this one answers
+  uint8_t num_sack_blocks;
+  uint16_t data_len; // bytes of payload in data
+  sack_block_t sack_blocks[MAX_SACK_BLOCKS];
+  char data[MAX_SEGMENT_DATA_SIZE];
 } tcp_segment_t;
 
+/**
+ * @brief Structure representing the fixed part of a TCP segment on the wire
+ *
+ * All fields are in network byte order. The header is followed by
+ * num_sack_blocks SACK blocks of two 32 bit sequence numbers each and then by
+ * data_len bytes of payload.
+ */
+typedef struct __attribute__((packed)) tcp_header {
+  uint16_t source_port;
+  uint16_t dest_port;
+  uint32_t seq_number;
+  uint32_t ack_number;
+  uint32_t window;
+  uint32_t ts_val;
+  uint32_t ts_ecr;
+  uint32_t checksum;
+  uint16_t data_len;
+  uint8_t head_len;
+  uint8_t flags;
+  uint8_t num_sack_blocks;
+  uint8_t checksum_type;
+  uint16_t reserved; // keeps the payload 4 byte aligned
+} tcp_header_t;
+
+// largest number of bytes the header of a TCP segment takes on the wire
+#define MAX_WIRE_HEADER_SIZE                                                   \
+  (sizeof(tcp_header_t) + MAX_SACK_BLOCKS * 2 * sizeof(uint32_t))
+
+// largest number of bytes a TCP segment takes on the wire
+#define MAX_WIRE_SEGMENT_SIZE (MAX_WIRE_HEADER_SIZE + MAX_SEGMENT_DATA_SIZE)
+
+/**
+ * @brief Structure representing the options carried by SYN and SYN-ACK
+ *
+ * The options are the payload of the SYN and SYN-ACK segments, in network
+ * byte order. The SYN proposes the checksum of the data segments and the
+ * SYN-ACK answers with the one the receiver accepts. The stripe fields follow
+ * only in the SYN of a striped transfer, whose streams each carry one byte
+ * range of the same file. A fast open cookie follows last: in a SYN it is the
+ * cookie of a previous connection, or 0 to ask for one, and in a SYN-ACK it
+ * is the cookie the receiver issues. A flags byte says which fields follow.
+ */
+typedef struct syn_options {
+  uint16_t segment_size; // largest payload the peer sends or accepts
+  uint8_t checksum_type; // checksum_type_t of the data segments
+  uint32_t transfer_id;  // shared by the streams of a transfer, 0 if none
+  uint16_t num_streams;  // streams of the transfer, 0 or 1 if not striped
+  uint64_t offset;       // file offset of the first byte of the stream
+  uint64_t total_bytes;  // size of the whole file
+  int fast_open;         // 1 if the cookie is carried
+  uint64_t cookie;       // fast open cookie, 0 in a SYN asking for one
+} syn_options_t;
+
+// bytes of the SYN options on the wire, without and with the stripe fields
+#define SYN_OPTIONS_SIZE 4
+#define STRIPED_SYN_OPTIONS_SIZE 28
+
+// flags of the SYN options, saying which optional fields follow
+#define SYN_OPTION_STRIPED 0x01 // the stripe fields
+#define SYN_OPTION_COOKIE 0x02  // the fast open cookie, after the stripe fields
+
+// bytes of the file digest carried by a FIN
+#define FIN_DIGEST_SIZE 8
+
+// reasons carried by the one byte payload of a RST
+#define RST_REASON_CLOSED 0x01          // the application closed the connection
+#define RST_REASON_DIGEST_MISMATCH 0x02 // the file differs from the one sent
+#define RST_REASON_WRITE_FAILED 0x03    // the file could not be written
+
 /**
  * @brief Enum representing the different flags in a TCP segment
  */
@@ -71,13 +170,27 @@ void create_tcp_segment(uint16_t source_port, uint16_t dest_port,
 /**
  * @brief Calculate the checksum of a TCP segment
  *
- * Calculate the checksum of a TCP segment
+ * Calculate the checksum_type checksum of the wire header, with a zero
+ * checksum field, and the data_len bytes of payload. head_len has to be set.
  *
  * @param segment Pointer to the segment
  * @return calculated checksum
 
 */
-uint16_t calculate_checksum(tcp_segment_t *segment);
+uint32_t calculate_checksum(tcp_segment_t *segment);
+
+/**
+ * @brief Calculate the checksum of a TCP segment whose payload is kept apart
+ *
+ * Same as calculate_checksum(), but the data_len bytes of payload are read
+ * from payload instead of the data field of the segment
+ *
+ * @param segment Pointer to the segment
+ * @param payload Pointer to the payload of the segment
+ * @return calculated checksum
+ */
+uint32_t calculate_payload_checksum(tcp_segment_t *segment,
+                                    const char *payload);
 
 /**
  * @brief Compare the checksum of a TCP segment
@@ -91,4 +204,97 @@ uint16_t calculate_checksum(tcp_segment_t *segment);
  */
 int compare_checksum(tcp_segment_t *segment);
 
+/**
+ * @brief Get the number of bytes the header of a TCP segment takes on the wire
+ *
+ * @param segment Pointer to the segment
+ * @return size of the header including the valid SACK blocks
+ */
+size_t tcp_header_length(tcp_segment_t *segment);
+
+/**
+ * @brief Write the header of a TCP segment in its wire format
+ *
+ * Write the header in network byte order followed by the valid SACK blocks,
+ * but not the payload
+ *
+ * @param segment Pointer to the segment
+ * @param buffer Buffer of at least MAX_WIRE_HEADER_SIZE bytes
+ * @return number of bytes written to buffer
+ */
+size_t serialize_tcp_header(tcp_segment_t *segment, unsigned char *buffer);
+
+/**
+ * @brief Write a TCP segment in its wire format
+ *
+ * Write the header in network byte order followed by the valid SACK blocks and
+ * the payload
+ *
+ * @param segment Pointer to the segment
+ * @param buffer Buffer of at least MAX_WIRE_SEGMENT_SIZE bytes
+ * @return number of bytes written to buffer
+ */
+size_t serialize_tcp_segment(tcp_segment_t *segment, unsigned char *buffer);
+
+/**
+ * @brief Read a TCP segment from its wire format
+ *
+ * @param buffer Buffer holding a received segment
+ * @param buffer_len Number of bytes received
+ * @param segment Pointer to the segment to be filled
+ * @return 1 if the buffer holds a well-formed segment, 0 otherwise
+ */
+int deserialize_tcp_segment(unsigned char *buffer, size_t buffer_len,
+                            tcp_segment_t *segment);
+
+/**
+ * @brief Write SYN options as the payload of a segment
+ *
+ * The stripe fields are only written if the transfer has several streams,
+ * and the cookie only if fast open is used.
+ *
+ * @param options Pointer to the options
+ * @param data Buffer of at least sizeof(syn_options_t) bytes
+ * @return number of bytes written to data
+ */
+size_t write_syn_options(syn_options_t *options, unsigned char *data);
+
+/**
+ * @brief Read the SYN options carried by a SYN or SYN-ACK segment
+ *
+ * The checksum, stripe and cookie fields are left untouched if the segment
+ * does not carry them.
+ *
+ * @param segment Pointer to the segment
+ * @param options Pointer to the options to be filled
+ * @return 1 if the segment carries the options, 0 otherwise
+ */
+int read_syn_options(tcp_segment_t *segment, syn_options_t *options);
+
+/**
+ * @brief Write the digest of the file as the payload of a FIN
+ *
+ * @param digest The digest of the data segments sent
+ * @param data Buffer of at least FIN_DIGEST_SIZE bytes
+ * @return number of bytes written to data
+ */
+size_t write_fin_digest(uint64_t digest, unsigned char *data);
+
+/**
+ * @brief Read the digest of the file carried by a FIN
+ *
+ * @param segment Pointer to the FIN
+ * @param digest Pointer where the digest is stored
+ * @return 1 if the segment carries a digest, 0 otherwise
+ */
+int read_fin_digest(tcp_segment_t *segment, uint64_t *digest);
+
+/**
+ * @brief Read the reason carried by a RST
+ *
+ * @param segment Pointer to the RST
+ * @return the RST_REASON_ the segment carries, 0 if it carries none
+ */
+int read_rst_reason(tcp_segment_t *segment);
+
 #endif
\ No newline at end of file
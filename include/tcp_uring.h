@@ -0,0 +1,119 @@
+/**
+ * @file tcp_uring.h
+ * @brief Function prototypes for driving an io_uring instance
+ *
+ * This header file contains the function prototypes for setting up an
+ * io_uring submission and completion queue pair with the raw system calls,
+ * preparing submission queue entries, submitting them and waiting for their
+ * completions with a single system call, and reading the completions back.
+ *
+ * @author Ritam Singal (ritamsingal)
+ * @author Harshil Patel (harshil-patel11)
+ * @bug No known bugs
+ */
+
+#ifndef TCP_URING_H
+#define TCP_URING_H
+
+#include <linux/io_uring.h>
+#include <stddef.h>
+
+/**
+ * @brief Structure holding the queues of an io_uring instance
+ *
+ * The head and tail pointers point into the rings shared with the kernel.
+ * Entries are prepared with get_uring_sqe() and handed to the kernel with
+ * submit_uring().
+ */
+typedef struct tcp_uring {
+  int ring_fd;               // -1 if the ring is not set up
+  unsigned *sq_head;         // first entry the kernel has not consumed
+  unsigned *sq_tail;         // one past the last submitted entry
+  unsigned *sq_mask;         // ring index mask of the submission queue
+  unsigned *sq_array;        // indices of the submitted entries
+  unsigned *cq_head;         // first completion not read yet
+  unsigned *cq_tail;         // one past the last posted completion
+  unsigned *cq_mask;         // ring index mask of the completion queue
+  struct io_uring_sqe *sqes; // submission queue entries
+  struct io_uring_cqe *cqes; // completion queue entries
+  unsigned sq_entries;       // entries in the submission queue
+  unsigned num_prepared;     // entries prepared since the last submission
+  void *sq_ring;             // mapping of the submission ring
+  size_t sq_ring_size;       // bytes of that mapping
+  void *cq_ring;             // mapping of the completion ring
+  size_t cq_ring_size;       // bytes of that mapping
+  size_t sqes_size;          // bytes of the entry mapping
+} tcp_uring_t;
+
+/**
+ * @brief Set up an io_uring instance
+ *
+ * @param ring The ring
+ * @param entries Entries in the submission queue, the kernel rounds it up to
+ * a power of two and sizes the completion queue twice as large
+ * @return int 0 if successful, -1 if the kernel has no io_uring support
+ */
+int init_tcp_uring(tcp_uring_t *ring, unsigned entries);
+
+/**
+ * @brief Tear down an io_uring instance
+ *
+ * @param ring The ring
+ */
+void free_tcp_uring(tcp_uring_t *ring);
+
+/**
+ * @brief Register a buffer for fixed reads and writes
+ *
+ * The buffer becomes buffer index 0 of IORING_OP_READ_FIXED and
+ * IORING_OP_WRITE_FIXED entries.
+ *
+ * @param ring The ring
+ * @param buffer The buffer
+ * @param length Bytes of the buffer
+ * @return int 0 if successful, -1 otherwise
+ */
+int register_uring_buffer(tcp_uring_t *ring, void *buffer, size_t length);
+
+/**
+ * @brief Get a cleared submission queue entry
+ *
+ * The entry is submitted by the next submit_uring() call.
+ *
+ * @param ring The ring
+ * @return struct io_uring_sqe* the entry, NULL if the queue is full
+ */
+struct io_uring_sqe *get_uring_sqe(tcp_uring_t *ring);
+
+/**
+ * @brief Get a cleared submission queue entry, making room if needed
+ *
+ * If the queue is full, the prepared entries are submitted without waiting
+ * for them, which frees their slots, and the entry is taken again.
+ *
+ * @param ring The ring
+ * @return struct io_uring_sqe* the entry, NULL if the queue could not be
+ * flushed
+ */
+struct io_uring_sqe *acquire_uring_sqe(tcp_uring_t *ring);
+
+/**
+ * @brief Submit the prepared entries and wait for completions
+ *
+ * @param ring The ring
+ * @param wait_nr Number of completions to wait for, counting the ones that
+ * have not been read yet
+ * @return int number of entries submitted, -1 on failure
+ */
+int submit_uring(tcp_uring_t *ring, unsigned wait_nr);
+
+/**
+ * @brief Read the next completion
+ *
+ * @param ring The ring
+ * @param cqe Pointer where the completion is copied
+ * @return int 1 if a completion was read, 0 if none is waiting
+ */
+int next_uring_cqe(tcp_uring_t *ring, struct io_uring_cqe *cqe);
+
+#endif // TCP_URING_H
@@ -13,10 +13,11 @@
 #ifndef TCP_UTILS_H
 #define TCP_UTILS_H
 
+#include <netinet/in.h>
+#include <stdint.h>
 #include <sys/time.h>
 
-#define MAX_WINDOW_SIZE 24        // maximum window size for sending packets
-#define DEFAULT_TIMEOUT_US 250000 // default timeout for receiving packets
+#include "tcp_segment.h"
 
 /**
  * @brief Enum representing the different errors in sending and receiving TCP
@@ -25,9 +26,14 @@ typedef enum tcp_error {
   SUCCESS = 0,
   CHECKSUM_FAILED = -1,
   TIMEOUT = -2,
-  RECV_FAILED = -3,    // failed to receive from socket
-  SEND_FAILED = -4,    // failed to send from socket
-  UNKNOWN_FAILURE = -5 // unknown failure
+  RECV_FAILED = -3,       // failed to receive from socket
+  SEND_FAILED = -4,       // failed to send from socket
+  UNKNOWN_FAILURE = -5,   // unknown failure
+  MALFORMED_SEGMENT = -6, // received datagram is not a valid segment
+  WRITE_FAILED = -7,      // failed to write received data to file
+  CONNECTION_RESET = -8,  // the peer aborted the connection with a RST
+  WOULD_BLOCK = -9,       // nothing can be sent or received without waiting
+  DIGEST_MISMATCH = -10   // the file received differs from the one sent
 } tcp_error_t;
 
 /**
@@ -39,6 +45,29 @@ typedef enum tcp_error {
  */
 int create_socket();
 
+/**
+ * @brief Set the size of a socket's buffers
+ *
+ * Ask the kernel for send and receive buffers of the given size, so that a
+ * full window of segments fits into them. The kernel may grant less.
+ *
+ * @param socket_desc Socket descriptor
+ * @param num_bytes Size of each buffer in bytes
+ */
+void set_socket_buffers(int socket_desc, size_t num_bytes);
+
+/**
+ * @brief Let several sockets bind to the same port
+ *
+ * Set SO_REUSEPORT before binding, so that the kernel spreads the datagrams
+ * over every socket bound to the port by a hash of the sender's address. The
+ * datagrams of one sender always reach the same socket.
+ *
+ * @param socket_desc Socket descriptor
+ * @return int 0 if successful, -1 if failed
+ */
+int set_socket_reuse_port(int socket_desc);
+
 /**
  * @brief Bind a socket
  *
@@ -74,10 +103,60 @@ int get_host_ip(char **ip);
  */
 int get_host_ip_by_hostname(char **ip, char *host);
 
+/**
+ * @brief Find the segment size that fits the path to a host
+ *
+ * Ask the kernel for the path MTU it knows for the route to the given address
+ * and return the largest payload that fits into one IP packet of that size
+ *
+ * @param addr Address of the peer
+ * @return int segment size in bytes, -1 if the path MTU is unknown
+ */
+int probe_segment_size(struct sockaddr_in *addr);
+
+/**
+ * @brief Encode a TCP segment for sending
+ *
+ * Stamp the segment with the current time, compute its checksum and write it
+ * in its wire format
+ *
+ * @param send_segment TCP segment to encode
+ * @param buffer Buffer of at least MAX_WIRE_SEGMENT_SIZE bytes
+ * @return size_t number of bytes written to buffer
+ */
+size_t encode_tcp(tcp_segment_t *send_segment, unsigned char *buffer);
+
+/**
+ * @brief Encode the header of a TCP segment whose payload is kept apart
+ *
+ * Same as encode_tcp(), but only the header is written and the checksum covers
+ * the data_len bytes at payload, which are sent after the header
+ *
+ * @param send_segment TCP segment to encode
+ * @param payload Pointer to the payload of the segment
+ * @param buffer Buffer of at least MAX_WIRE_HEADER_SIZE bytes
+ * @return size_t number of bytes written to buffer
+ */
+size_t encode_tcp_header(tcp_segment_t *send_segment, const char *payload,
+                         unsigned char *buffer);
+
+/**
+ * @brief Decode a received TCP segment
+ *
+ * @param buffer Buffer holding the received datagram
+ * @param length Number of bytes received
+ * @param recv_segment TCP segment to fill
+ * @return SUCCESS if successful, MALFORMED_SEGMENT if the datagram is not a
+ * valid segment, CHECKSUM_FAILED if checksums don't match
+ */
+tcp_error_t decode_tcp(unsigned char *buffer, size_t length,
+                       tcp_segment_t *recv_segment);
+
 /**
  * @brief Send a TCP segment
  *
- * Send a TCP segment to the given server address
+ * Send a TCP segment to the given server address. The segment is stamped with
+ * the current time and its checksum is computed just before it is sent.
  *
  * @param socket_desc Socket descriptor
  * @param send_segment TCP segment to send
@@ -96,7 +175,8 @@ tcp_error_t send_tcp(int socket_desc, tcp_segment_t *send_segment,
  * @param client_addr Client address
  * @param recv_segment TCP segment to receive
  * @return SUCCESS if successful, CHECKSUM_FAILED if checksums don't match,
- * RECV_FAILED if failed to receive from socket
+ * MALFORMED_SEGMENT if the datagram is not a valid segment, RECV_FAILED if
+ * failed to receive from socket
  */
 tcp_error_t recv_tcp(int socket_desc, struct sockaddr_in *client_addr,
                      tcp_segment_t *recv_segment);
@@ -109,12 +189,24 @@ tcp_error_t recv_tcp(int socket_desc, struct sockaddr_in *client_addr,
  * @param socket_desc Socket descriptor
  * @param client_addr Client address
  * @param recv_segment TCP segment to receive
+ * @param timeout_us Maximum time to wait for a segment in microseconds
  * @return SUCCESS if successful, CHECKSUM_FAILED if checksums don't match,
- * TIMEOUT if timeout occurs, RECV_FAILED if failed to receive from socket,
+ * MALFORMED_SEGMENT if the datagram is not a valid segment, TIMEOUT if
+ * timeout occurs, RECV_FAILED if failed to receive from socket,
  * UNKNOWN_FAILURE if unknown failure
  */
 tcp_error_t recv_tcp_with_timeout(int socket_desc,
                                   struct sockaddr_in *client_addr,
-                                  tcp_segment_t *recv_segment);
+                                  tcp_segment_t *recv_segment,
+                                  long timeout_us);
+
+/**
+ * @brief Get the current time in microseconds
+ *
+ * Read the monotonic clock, used for retransmission deadlines
+ *
+ * @return uint64_t current time in microseconds
+ */
+uint64_t get_time_us();
 
 #endif // TCP_UTILS_H
\ No newline at end of file
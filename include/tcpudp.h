@@ -0,0 +1,216 @@
+#ifndef TCPUDP_H
+#define TCPUDP_H
+
+/**
+ * @file tcpudp.h
+ *
+ * @brief Function prototypes for the connections of libtcpudp
+ *
+ * This header file contains the function prototypes for embedding the
+ * transport in an application as a byte stream instead of a file transfer:
+ * opening a connection, listening for and accepting connections, sending and
+ * receiving bytes, and closing a connection. Like a transfer, a connection
+ * carries bytes one way, from the end opened by tcpudp_connect() to the end
+ * returned by tcpudp_accept().
+ *
+ * Sending and receiving never wait. Each connection and listener has a
+ * descriptor the application can poll, and once it is readable
+ * tcpudp_process() handles the segments and timers that are due. Opening and
+ * closing the sending end wait for the handshakes.
+ *
+ * @author Ritam Singal (ritamsingal)
+ * @author Harshil Patel (harshil-patel11)
+ * @bug No known bugs
+ */
+
+#include <sys/types.h>
+
+#include "receiver.h"
+#include "sender.h"
+
+/**
+ * @brief Structure holding the counters of a connection
+ */
+typedef struct tcpudp_stats {
+  uint64_t bytes_sent;             // bytes taken by tcpudp_send()
+  uint64_t bytes_received;         // bytes returned by tcpudp_recv()
+  uint64_t segments_sent;          // transmissions, retransmissions included
+  uint64_t segments_retransmitted; // transmissions of segments sent before
+  long srtt_us;                    // smoothed round trip time
+  long rto_us;                     // current retransmission timeout
+  uint32_t congestion_window;      // segments the sender may have in flight
+  uint32_t receive_window;         // segments the receiver may take
+  double pacing_rate;              // bytes per second sent, 0 if not paced
+} tcpudp_stats_t;
+
+/**
+ * @brief Structure holding a receiver that accepts connections
+ */
+typedef struct tcpudp_listener {
+  receiver_options_t options; // options of the receiver, in stream mode
+  receiver_state_t state;
+  event_loop_t loop; // loop of every accepted connection
+} tcpudp_listener_t;
+
+/**
+ * @brief Structure holding one end of a connection
+ *
+ * The sending end owns its socket, window and event loop, like a transfer of
+ * rsend(). The receiving end is a connection of its listener, whose loop
+ * receives the segments of every accepted connection.
+ */
+typedef struct tcpudp_conn {
+  sender_state_t sender;
+  send_window_t window;
+  send_buffer_t buffer;
+  rtt_estimator_t rtt;
+  congestion_control_t cc;
+  tcp_io_t io;
+  event_loop_t loop;
+  struct sockaddr_in server_addr; // address of the receiver
+  struct sockaddr_in client_addr; // address of the sender
+  connection_t *connection;       // receiving end, or NULL for the sender
+  tcpudp_listener_t *listener;    // listener that accepted the connection
+  int error;                      // error that broke the connection
+  uint64_t bytes_sent;            // bytes taken by tcpudp_send()
+  uint64_t bytes_received;        // bytes returned by tcpudp_recv()
+} tcpudp_conn_t;
+
+/**
+ * @brief Open a connection to a receiver
+ *
+ * Wait for the handshake with the listener at the given host and port, and
+ * set up the sending end of the connection.
+ *
+ * @param hostname The hostname of the receiver
+ * @param port The UDP port of the receiver
+ * @param options The options of the sender
+ * @return tcpudp_conn_t* the connection, or NULL if it could not be opened
+ */
+tcpudp_conn_t *tcpudp_connect(char *hostname, unsigned short int port,
+                              sender_options_t *options);
+
+/**
+ * @brief Listen for connections
+ *
+ * Bind a receiver to the given port that holds the data of each connection
+ * until the application reads it. The options are copied, and the receiver
+ * runs in server mode on a single worker whatever they say.
+ *
+ * @param port The UDP port to bind
+ * @param options The options of the receiver
+ * @return tcpudp_listener_t* the listener, or NULL if it could not be bound
+ */
+tcpudp_listener_t *tcpudp_listen(unsigned short int port,
+                                 receiver_options_t *options);
+
+/**
+ * @brief Accept a connection
+ *
+ * Handle the segments that arrived on the listener, and take the oldest
+ * connection that was opened and not accepted yet.
+ *
+ * @param listener The listener
+ * @return tcpudp_conn_t* the receiving end of the connection, or NULL if no
+ * connection is waiting
+ */
+tcpudp_conn_t *tcpudp_accept(tcpudp_listener_t *listener);
+
+/**
+ * @brief Send bytes on a connection
+ *
+ * Copy as many bytes as the send buffer has room for, and send the segments
+ * the windows allow. A segment that is not full is held back until more
+ * bytes fill it or tcpudp_flush() is called.
+ *
+ * @param conn The sending end of the connection
+ * @param data The bytes
+ * @param len Number of bytes
+ * @return ssize_t number of bytes taken, WOULD_BLOCK if the buffer is full,
+ * or the error that broke the connection
+ */
+ssize_t tcpudp_send(tcpudp_conn_t *conn, const void *data, size_t len);
+
+/**
+ * @brief Send the bytes held back in a segment that is not full
+ *
+ * @param conn The sending end of the connection
+ * @return int SUCCESS, or the error that broke the connection
+ */
+int tcpudp_flush(tcpudp_conn_t *conn);
+
+/**
+ * @brief Receive bytes from a connection
+ *
+ * Copy the bytes that arrived in order and were not read yet. Reading frees
+ * receive buffer, and the sender is told once half of it is free again.
+ *
+ * @param conn The receiving end of the connection
+ * @param data The buffer to copy the bytes to
+ * @param len Size of the buffer
+ * @return ssize_t number of bytes copied, 0 once the sender closed the
+ * connection and every byte was read, WOULD_BLOCK if no byte arrived yet, or
+ * the error that broke the connection
+ */
+ssize_t tcpudp_recv(tcpudp_conn_t *conn, void *data, size_t len);
+
+/**
+ * @brief Handle the segments and timers that are due on a connection
+ *
+ * @param conn The connection
+ * @return int SUCCESS, or the error that broke the connection
+ */
+int tcpudp_process(tcpudp_conn_t *conn);
+
+/**
+ * @brief Get the descriptor that is readable when a connection has work
+ *
+ * Accepted connections share the descriptor of their listener.
+ *
+ * @param conn The connection
+ * @return int the descriptor
+ */
+int tcpudp_fileno(tcpudp_conn_t *conn);
+
+/**
+ * @brief Get the descriptor that is readable when a listener has work
+ *
+ * @param listener The listener
+ * @return int the descriptor
+ */
+int tcpudp_listener_fileno(tcpudp_listener_t *listener);
+
+/**
+ * @brief Get the counters of a connection
+ *
+ * @param conn The connection
+ * @param stats The counters to fill
+ */
+void tcpudp_get_stats(tcpudp_conn_t *conn, tcpudp_stats_t *stats);
+
+/**
+ * @brief Close a connection
+ *
+ * The sending end waits until every byte was acknowledged and the receiver
+ * answered the FIN, which carries the digest of the stream. The receiving
+ * end resets the connection if the sender did not close it yet. Either way
+ * the connection is freed.
+ *
+ * @param conn The connection
+ * @return int SUCCESS, DIGEST_MISMATCH if the receiver rejected the digest,
+ * CONNECTION_RESET if the application on the other end closed first, TIMEOUT
+ * if it never answered the FIN, or the error that broke the connection
+ */
+int tcpudp_close(tcpudp_conn_t *conn);
+
+/**
+ * @brief Close a listener
+ *
+ * The accepted connections have to be closed first, the ones that were not
+ * accepted are freed with the listener.
+ *
+ * @param listener The listener
+ */
+void tcpudp_close_listener(tcpudp_listener_t *listener);
+
+#endif
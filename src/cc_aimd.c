@@ -0,0 +1,53 @@
+/**
+ * @file cc_aimd.c
+ * @brief Function definitions for the AIMD congestion control algorithm
+ *
+ * This file contains the hooks of the additive increase, multiplicative
+ * decrease algorithm: the window grows by 2 segments for every window of
+ * acknowledged segments, is halved on a loss and drops to 1 segment on a
+ * timeout.
+ *
+ * @author Ritam Singal (ritamsingal)
+ * @author Harshil Patel (harshil-patel11)
+ * @bug No known bugs
+ */
+
+#include "../include/congestion_control.h"
+#include "../include/utils.h"
+
+// segments added to the window per window of acknowledged segments
+#define AIMD_INCREASE 2
+
+void aimd_init(congestion_control_t *cc) { cc->cwnd = 1; }
+
+void aimd_on_ack(congestion_control_t *cc, int num_acked, long rtt_us,
+                 uint32_t in_flight, uint64_t now_us) {
+  (void)rtt_us;
+  (void)in_flight;
+  (void)now_us;
+  cc->cwnd += AIMD_INCREASE * (double)num_acked / cc->cwnd;
+}
+
+void aimd_on_loss(congestion_control_t *cc, uint64_t now_us) {
+  (void)now_us;
+  cc->cwnd = MAX(1, cc->cwnd / 2);
+}
+
+void aimd_on_timeout(congestion_control_t *cc, uint64_t now_us) {
+  (void)now_us;
+  cc->cwnd = 1;
+}
+
+double aimd_pacing_rate(congestion_control_t *cc) {
+  (void)cc;
+  return 0;
+}
+
+const congestion_ops_t aimd_ops = {
+    .name = "aimd",
+    .init = aimd_init,
+    .on_ack = aimd_on_ack,
+    .on_loss = aimd_on_loss,
+    .on_timeout = aimd_on_timeout,
+    .pacing_rate = aimd_pacing_rate,
+};
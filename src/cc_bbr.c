@@ -0,0 +1,160 @@
+/**
+ * @file cc_bbr.c
+ * @brief Function definitions for the BBR congestion control algorithm
+ *
+ * This file contains the hooks of a BBR-style algorithm. Instead of reacting
+ * to losses, it models the path by its bottleneck bandwidth (the highest
+ * delivery rate seen over the last rounds) and its minimum RTT, paces at a
+ * multiple of the bandwidth, and keeps about twice the bandwidth-delay product
+ * in flight. Random losses that are not caused by congestion therefore do not
+ * shrink the window.
+ *
+ * @author Ritam Singal (ritamsingal)
+ * @author Harshil Patel (harshil-patel11)
+ * @bug No known bugs
+ */
+
+#include <string.h>
+
+#include "../include/congestion_control.h"
+#include "../include/utils.h"
+
+#define BBR_HIGH_GAIN 2.885            // 2/ln(2), doubles the rate every round
+#define BBR_MIN_CWND 4                 // segments kept in flight at least
+#define BBR_MIN_RTT_EXPIRY_US 10000000 // min RTT is measured again after this
+#define BBR_PROBE_RTT_US 200000        // time spent with a small window
+#define BBR_FULL_BW_ROUNDS 3           // rounds without growth that end startup
+
+// pacing gains of the PROBE_BW phase, one per round
+static const double bbr_gain_cycle[] = {1.25, 0.75, 1, 1, 1, 1, 1, 1};
+
+void bbr_init(congestion_control_t *cc) {
+  bbr_state_t *bbr = &cc->bbr;
+  memset(bbr, 0, sizeof(*bbr));
+  bbr->mode = BBR_STARTUP;
+  bbr->min_rtt_us = -1;
+  bbr->pacing_gain = BBR_HIGH_GAIN;
+  bbr->cwnd_gain = BBR_HIGH_GAIN;
+  cc->cwnd = 1;
+}
+
+double bbr_bdp(bbr_state_t *bbr) {
+  return bbr->max_bw * MAX(0, bbr->min_rtt_us) / 1e6;
+}
+
+void bbr_update_mode(congestion_control_t *cc, uint32_t in_flight,
+                     uint64_t now_us) {
+  bbr_state_t *bbr = &cc->bbr;
+
+  switch (bbr->mode) {
+  case BBR_STARTUP:
+    // startup ends once the bandwidth stops growing by 25% per round
+    if (bbr->max_bw >= bbr->full_bw * 1.25) {
+      bbr->full_bw = bbr->max_bw;
+      bbr->full_bw_rounds = 0;
+    } else if (++bbr->full_bw_rounds >= BBR_FULL_BW_ROUNDS) {
+      bbr->mode = BBR_DRAIN;
+      bbr->pacing_gain = 1 / BBR_HIGH_GAIN;
+    }
+    break;
+  case BBR_DRAIN:
+    if (in_flight <= bbr_bdp(bbr)) {
+      bbr->mode = BBR_PROBE_BW;
+      bbr->cycle_index = 0;
+      bbr->pacing_gain = bbr_gain_cycle[0];
+      bbr->cwnd_gain = 2;
+    }
+    break;
+  case BBR_PROBE_BW:
+    bbr->cycle_index = (bbr->cycle_index + 1) % 8;
+    bbr->pacing_gain = bbr_gain_cycle[bbr->cycle_index];
+    break;
+  case BBR_PROBE_RTT:
+    if (now_us >= bbr->probe_rtt_done_us) {
+      bbr->min_rtt_stamp_us = now_us;
+      bbr->mode = BBR_PROBE_BW;
+      bbr->cycle_index = 0;
+      bbr->pacing_gain = bbr_gain_cycle[0];
+      bbr->cwnd_gain = 2;
+    }
+    break;
+  }
+}
+
+void bbr_on_ack(congestion_control_t *cc, int num_acked, long rtt_us,
+                uint32_t in_flight, uint64_t now_us) {
+  bbr_state_t *bbr = &cc->bbr;
+
+  if (rtt_us >= 0 && (bbr->min_rtt_us < 0 || rtt_us <= bbr->min_rtt_us)) {
+    bbr->min_rtt_us = rtt_us;
+    bbr->min_rtt_stamp_us = now_us;
+  }
+
+  // one delivery rate sample per round of at least one minimum RTT
+  if (bbr->round_start_us == 0) {
+    bbr->round_start_us = now_us;
+  }
+  bbr->delivered_in_round += num_acked;
+  uint64_t round_us = MAX(bbr->min_rtt_us, 1000);
+  if (now_us - bbr->round_start_us >= round_us) {
+    double rate =
+        bbr->delivered_in_round * 1e6 / (now_us - bbr->round_start_us);
+    bbr->bw_samples[bbr->bw_index] = rate;
+    bbr->bw_index = (bbr->bw_index + 1) % BBR_BW_SAMPLES;
+    bbr->max_bw = 0;
+    for (int i = 0; i < BBR_BW_SAMPLES; i++) {
+      bbr->max_bw = MAX(bbr->max_bw, bbr->bw_samples[i]);
+    }
+    bbr->round_start_us = now_us;
+    bbr->delivered_in_round = 0;
+    // drain ends on what is left in flight once this ACK arrived
+    bbr_update_mode(cc, in_flight - MIN(in_flight, (uint32_t)num_acked),
+                    now_us);
+  }
+
+  // measure the minimum RTT again once it is too old
+  if (bbr->mode != BBR_PROBE_RTT && bbr->mode != BBR_STARTUP &&
+      now_us - bbr->min_rtt_stamp_us > BBR_MIN_RTT_EXPIRY_US) {
+    bbr->mode = BBR_PROBE_RTT;
+    bbr->pacing_gain = 1;
+    bbr->min_rtt_us = -1;
+    bbr->probe_rtt_done_us = now_us + BBR_PROBE_RTT_US;
+  }
+
+  if (bbr->mode == BBR_PROBE_RTT) {
+    cc->cwnd = BBR_MIN_CWND;
+    return;
+  }
+
+  // grow like slow start until the model knows the path, then towards a
+  // multiple of the bandwidth-delay product
+  cc->cwnd += num_acked;
+  if (bbr->max_bw > 0 && bbr->min_rtt_us >= 0) {
+    double target = MAX(BBR_MIN_CWND, bbr->cwnd_gain * bbr_bdp(bbr));
+    cc->cwnd = MIN(cc->cwnd, target);
+  }
+}
+
+void bbr_on_loss(congestion_control_t *cc, uint64_t now_us) {
+  // the model, not loss, sets the window
+  (void)cc;
+  (void)now_us;
+}
+
+void bbr_on_timeout(congestion_control_t *cc, uint64_t now_us) {
+  (void)now_us;
+  cc->cwnd = BBR_MIN_CWND;
+}
+
+double bbr_pacing_rate(congestion_control_t *cc) {
+  return cc->bbr.pacing_gain * cc->bbr.max_bw;
+}
+
+const congestion_ops_t bbr_ops = {
+    .name = "bbr",
+    .init = bbr_init,
+    .on_ack = bbr_on_ack,
+    .on_loss = bbr_on_loss,
+    .on_timeout = bbr_on_timeout,
+    .pacing_rate = bbr_pacing_rate,
+};
@@ -0,0 +1,108 @@
+/**
+ * @file cc_cubic.c
+ * @brief Function definitions for the CUBIC congestion control algorithm
+ *
+ * This file contains the hooks of CUBIC as described in RFC 8312: after a
+ * loss the window follows a cubic function of the time since the loss, which
+ * grows back to the window where the loss happened quickly, stays around it,
+ * and then probes for more bandwidth. Before the first loss the window grows
+ * exponentially in slow start.
+ *
+ * @author Ritam Singal (ritamsingal)
+ * @author Harshil Patel (harshil-patel11)
+ * @bug No known bugs
+ */
+
+#include <math.h>
+
+#include "../include/congestion_control.h"
+#include "../include/utils.h"
+
+#define CUBIC_C 0.4    // scaling constant of the cubic function
+#define CUBIC_BETA 0.7 // multiplicative decrease factor
+
+void cubic_init(congestion_control_t *cc) {
+  cc->cwnd = 1;
+  cc->cubic.w_max = 0;
+  cc->cubic.k = 0;
+  cc->cubic.epoch_us = 0;
+  cc->cubic.w_est = 0;
+  cc->cubic.min_rtt_us = -1;
+}
+
+void cubic_on_ack(congestion_control_t *cc, int num_acked, long rtt_us,
+                  uint32_t in_flight, uint64_t now_us) {
+  (void)in_flight;
+  cubic_state_t *cubic = &cc->cubic;
+  if (rtt_us >= 0 && (cubic->min_rtt_us < 0 || rtt_us < cubic->min_rtt_us)) {
+    cubic->min_rtt_us = rtt_us;
+  }
+
+  if (cc->cwnd < cc->ssthresh) {
+    cc->cwnd += num_acked;
+    return;
+  }
+
+  if (cubic->epoch_us == 0) {
+    cubic->epoch_us = now_us;
+    if (cc->cwnd < cubic->w_max) {
+      cubic->k = cbrt((cubic->w_max - cc->cwnd) / CUBIC_C);
+    } else {
+      cubic->k = 0;
+      cubic->w_max = cc->cwnd;
+    }
+    cubic->w_est = cc->cwnd;
+  }
+
+  // window the cubic function reaches one RTT from now
+  double rtt_s = MAX(0, cubic->min_rtt_us) / 1e6;
+  double t = (now_us - cubic->epoch_us) / 1e6 + rtt_s - cubic->k;
+  double target = CUBIC_C * t * t * t + cubic->w_max;
+  if (target > cc->cwnd) {
+    cc->cwnd += (target - cc->cwnd) / cc->cwnd * num_acked;
+  } else {
+    cc->cwnd += 0.01 * num_acked / cc->cwnd;
+  }
+
+  // never grow slower than standard TCP would in the same conditions
+  cubic->w_est +=
+      3 * (1 - CUBIC_BETA) / (1 + CUBIC_BETA) * num_acked / cc->cwnd;
+  if (cubic->w_est > cc->cwnd) {
+    cc->cwnd = cubic->w_est;
+  }
+}
+
+void cubic_on_loss(congestion_control_t *cc, uint64_t now_us) {
+  (void)now_us;
+  cubic_state_t *cubic = &cc->cubic;
+  cubic->epoch_us = 0;
+
+  // fast convergence: release bandwidth to newer flows
+  if (cc->cwnd < cubic->w_max) {
+    cubic->w_max = cc->cwnd * (1 + CUBIC_BETA) / 2;
+  } else {
+    cubic->w_max = cc->cwnd;
+  }
+  cc->cwnd = MAX(1, cc->cwnd * CUBIC_BETA);
+  cc->ssthresh = cc->cwnd;
+}
+
+void cubic_on_timeout(congestion_control_t *cc, uint64_t now_us) {
+  cubic_on_loss(cc, now_us);
+  cc->ssthresh = MAX(2, cc->ssthresh);
+  cc->cwnd = 1;
+}
+
+double cubic_pacing_rate(congestion_control_t *cc) {
+  (void)cc;
+  return 0;
+}
+
+const congestion_ops_t cubic_ops = {
+    .name = "cubic",
+    .init = cubic_init,
+    .on_ack = cubic_on_ack,
+    .on_loss = cubic_on_loss,
+    .on_timeout = cubic_on_timeout,
+    .pacing_rate = cubic_pacing_rate,
+};
@@ -0,0 +1,178 @@
+/**
+ * @file checksum.c
+ * @brief Function definitions for the checksums that protect segments
+ *
+ * This file contains the function definitions for the 16 bit one's complement
+ * sum of RFC 1071, accumulated a word or a vector at a time, and for CRC32C,
+ * computed with the SSE4.2 instruction where the CPU has it. The vector and
+ * SSE4.2 variants are picked at run time.
+ *
+ * @author Ritam Singal (ritamsingal)
+ * @author Harshil Patel (harshil-patel11)
+ * @bug No known bugs
+ */
+
+#include <arpa/inet.h>
+#include <string.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#endif
+
+#include "../include/checksum.h"
+
+#define CRC32C_POLYNOMIAL 0x82F63B78 // Castagnoli polynomial, bit-reflected
+
+int parse_checksum_type(const char *name, checksum_type_t *type) {
+  if (strcmp(name, "internet") == 0) {
+    *type = CHECKSUM_INTERNET;
+  } else if (strcmp(name, "crc32c") == 0) {
+    *type = CHECKSUM_CRC32C;
+  } else {
+    return -1;
+  }
+  return 0;
+}
+
+uint32_t compute_checksum(checksum_type_t type, const void *header,
+                          size_t header_len, const void *payload,
+                          size_t payload_len) {
+  if (type == CHECKSUM_CRC32C) {
+    uint32_t crc = crc32c_update(~0u, header, header_len);
+    return ~crc32c_update(crc, payload, payload_len);
+  }
+
+  uint64_t sum = ones_complement_add(0, header, header_len);
+  sum = ones_complement_add(sum, payload, payload_len);
+  // the folded sum is in memory order, which is network byte order
+  return ntohs((uint16_t)~ones_complement_fold(sum));
+}
+
+uint64_t ones_complement_add(uint64_t sum, const void *data, size_t len) {
+#if defined(__x86_64__) || defined(__i386__)
+  if (len >= 64 && __builtin_cpu_supports("avx2")) {
+    return ones_complement_add_avx2(sum, data, len);
+  }
+#endif
+  return ones_complement_add_words(sum, data, len);
+}
+
+uint64_t ones_complement_add_words(uint64_t sum, const void *data,
+                                   size_t len) {
+  // 32 bit words added into 64 bit sums cannot overflow for any segment, and
+  // two sums keep the additions independent
+  const unsigned char *bytes = data;
+  uint64_t sums[2] = {0, 0};
+  while (len >= 16) {
+    uint32_t words[4];
+    memcpy(words, bytes, sizeof(words));
+    sums[0] += words[0];
+    sums[1] += words[1];
+    sums[0] += words[2];
+    sums[1] += words[3];
+    bytes += 16;
+    len -= 16;
+  }
+  while (len > 0) {
+    uint32_t words[2] = {0, 0};
+    size_t chunk = len < sizeof(words) ? len : sizeof(words);
+    memcpy(words, bytes, chunk);
+    sums[0] += words[0];
+    sums[1] += words[1];
+    bytes += chunk;
+    len -= chunk;
+  }
+
+  // 2^64 - 1 is a multiple of 2^16 - 1, so a 64 bit one's complement sum
+  // folds to the same 16 bit sum
+  for (int i = 0; i < 2; i++) {
+    sum += sums[i];
+    sum += sum < sums[i];
+  }
+  return sum;
+}
+
+#if defined(__x86_64__) || defined(__i386__)
+__attribute__((target("avx2"))) uint64_t
+ones_complement_add_avx2(uint64_t sum, const void *data, size_t len) {
+  // each 32 byte load is widened to eight 32 bit words in 64 bit lanes
+  const unsigned char *bytes = data;
+  __m256i zero = _mm256_setzero_si256();
+  __m256i sums = _mm256_setzero_si256();
+  while (len >= 32) {
+    __m256i words = _mm256_loadu_si256((const __m256i *)bytes);
+    sums = _mm256_add_epi64(sums, _mm256_unpacklo_epi32(words, zero));
+    sums = _mm256_add_epi64(sums, _mm256_unpackhi_epi32(words, zero));
+    bytes += 32;
+    len -= 32;
+  }
+
+  uint64_t lanes[4];
+  _mm256_storeu_si256((__m256i *)lanes, sums);
+  for (int i = 0; i < 4; i++) {
+    sum += lanes[i];
+    sum += sum < lanes[i];
+  }
+  return ones_complement_add_words(sum, bytes, len);
+}
+#endif
+
+uint16_t ones_complement_fold(uint64_t sum) {
+  sum = (sum & 0xFFFFFFFF) + (sum >> 32);
+  sum = (sum & 0xFFFFFFFF) + (sum >> 32);
+  sum = (sum & 0xFFFF) + (sum >> 16);
+  sum = (sum & 0xFFFF) + (sum >> 16);
+  sum = (sum & 0xFFFF) + (sum >> 16);
+  return (uint16_t)sum;
+}
+
+uint32_t crc32c_update(uint32_t crc, const void *data, size_t len) {
+#if defined(__x86_64__) || defined(__i386__)
+  if (__builtin_cpu_supports("sse4.2")) {
+    return crc32c_update_sse42(crc, data, len);
+  }
+#endif
+  return crc32c_update_bits(crc, data, len);
+}
+
+uint32_t crc32c_update_bits(uint32_t crc, const void *data, size_t len) {
+  const unsigned char *bytes = data;
+  for (size_t i = 0; i < len; i++) {
+    crc ^= bytes[i];
+    for (int bit = 0; bit < 8; bit++) {
+      crc = (crc >> 1) ^ (CRC32C_POLYNOMIAL & -(crc & 1));
+    }
+  }
+  return crc;
+}
+
+#if defined(__x86_64__) || defined(__i386__)
+__attribute__((target("sse4.2"))) uint32_t
+crc32c_update_sse42(uint32_t crc, const void *data, size_t len) {
+  const unsigned char *bytes = data;
+#if defined(__x86_64__)
+  uint64_t crc64 = crc;
+  while (len >= 8) {
+    uint64_t word;
+    memcpy(&word, bytes, sizeof(word));
+    crc64 = _mm_crc32_u64(crc64, word);
+    bytes += 8;
+    len -= 8;
+  }
+  crc = (uint32_t)crc64;
+#endif
+  while (len >= 4) {
+    uint32_t word;
+    memcpy(&word, bytes, sizeof(word));
+    crc = _mm_crc32_u32(crc, word);
+    bytes += 4;
+    len -= 4;
+  }
+  while (len > 0) {
+    crc = _mm_crc32_u8(crc, *bytes);
+    bytes++;
+    len--;
+  }
+  return crc;
+}
+#endif
@@ -0,0 +1,77 @@
+/**
+ * @file congestion_control.c
+ * @brief Function definitions for selecting and driving a congestion control
+ * algorithm
+ *
+ * This file contains the function definitions for initializing the congestion
+ * control of a connection with one of the available algorithms, parsing
+ * algorithm names, and forwarding the sender's events to the algorithm's
+ * hooks.
+ *
+ * @author Ritam Singal (ritamsingal)
+ * @author Harshil Patel (harshil-patel11)
+ * @bug No known bugs
+ */
+
+#include <string.h>
+
+#include "../include/congestion_control.h"
+#include "../include/utils.h"
+
+void init_congestion_control(congestion_control_t *cc,
+                             cc_algorithm_t algorithm, int max_cwnd) {
+  memset(cc, 0, sizeof(*cc));
+  cc->max_cwnd = max_cwnd;
+  cc->cwnd = 1;
+  cc->ssthresh = max_cwnd;
+
+  switch (algorithm) {
+  case CC_CUBIC:
+    cc->ops = &cubic_ops;
+    break;
+  case CC_BBR:
+    cc->ops = &bbr_ops;
+    break;
+  default:
+    cc->ops = &aimd_ops;
+    break;
+  }
+  cc->ops->init(cc);
+}
+
+int parse_cc_algorithm(const char *name, cc_algorithm_t *algorithm) {
+  if (strcmp(name, aimd_ops.name) == 0) {
+    *algorithm = CC_AIMD;
+  } else if (strcmp(name, cubic_ops.name) == 0) {
+    *algorithm = CC_CUBIC;
+  } else if (strcmp(name, bbr_ops.name) == 0) {
+    *algorithm = CC_BBR;
+  } else {
+    return -1;
+  }
+  return 0;
+}
+
+void cc_on_ack(congestion_control_t *cc, int num_acked, long rtt_us,
+               uint32_t in_flight, uint64_t now_us) {
+  cc->ops->on_ack(cc, num_acked, rtt_us, in_flight, now_us);
+  cc->cwnd = MIN(cc->cwnd, cc->max_cwnd);
+}
+
+void cc_on_loss(congestion_control_t *cc, uint64_t now_us) {
+  cc->ops->on_loss(cc, now_us);
+  cc->cwnd = MAX(1, cc->cwnd);
+}
+
+void cc_on_timeout(congestion_control_t *cc, uint64_t now_us) {
+  cc->ops->on_timeout(cc, now_us);
+  cc->cwnd = MAX(1, cc->cwnd);
+}
+
+int cc_window(congestion_control_t *cc) {
+  return MAX(1, MIN((int)cc->cwnd, cc->max_cwnd));
+}
+
+double cc_pacing_rate(congestion_control_t *cc) {
+  return cc->ops->pacing_rate(cc);
+}
@@ -0,0 +1,219 @@
+/**
+ * @file fast_open.c
+ * @brief Function definitions for fast open cookies
+ *
+ * This file contains the function definitions for SipHash-2-4, the cookies
+ * and initial sequence numbers receivers compute with it, the file
+ * receivers can keep their key in, and the file senders keep their cookies
+ * in. Each line of the cookie file holds the address, port, cookie and
+ * segment size of one receiver.
+ *
+ * @author Ritam Singal (ritamsingal)
+ * @author Harshil Patel (harshil-patel11)
+ * @bug No known bugs
+ */
+
+#include <arpa/inet.h>
+#include <endian.h>
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <sys/random.h>
+#include <unistd.h>
+
+#include "../include/fast_open.h"
+#include "../include/tcp_utils.h"
+
+#define SIP_ROTL(x, b) (((x) << (b)) | ((x) >> (64 - (b))))
+
+// one SipRound mixes the four state words
+#define SIP_ROUND(v0, v1, v2, v3)                                              \
+  do {                                                                         \
+    v0 += v1;                                                                  \
+    v1 = SIP_ROTL(v1, 13);                                                     \
+    v1 ^= v0;                                                                  \
+    v0 = SIP_ROTL(v0, 32);                                                     \
+    v2 += v3;                                                                  \
+    v3 = SIP_ROTL(v3, 16);                                                     \
+    v3 ^= v2;                                                                  \
+    v0 += v3;                                                                  \
+    v3 = SIP_ROTL(v3, 21);                                                     \
+    v3 ^= v0;                                                                  \
+    v2 += v1;                                                                  \
+    v1 = SIP_ROTL(v1, 17);                                                     \
+    v1 ^= v2;                                                                  \
+    v2 = SIP_ROTL(v2, 32);                                                     \
+  } while (0)
+
+uint64_t siphash24(const uint64_t key[2], const void *data, size_t len) {
+  const unsigned char *bytes = data;
+  uint64_t v0 = key[0] ^ 0x736f6d6570736575ULL;
+  uint64_t v1 = key[1] ^ 0x646f72616e646f6dULL;
+  uint64_t v2 = key[0] ^ 0x6c7967656e657261ULL;
+  uint64_t v3 = key[1] ^ 0x7465646279746573ULL;
+
+  size_t num_words = len / 8;
+  for (size_t i = 0; i < num_words; i++) {
+    uint64_t word;
+    memcpy(&word, bytes + 8 * i, sizeof(word));
+    word = le64toh(word);
+    v3 ^= word;
+    SIP_ROUND(v0, v1, v2, v3);
+    SIP_ROUND(v0, v1, v2, v3);
+    v0 ^= word;
+  }
+
+  // the last word holds the remaining bytes and the length
+  uint64_t last = (uint64_t)len << 56;
+  for (size_t i = 0; i < len % 8; i++) {
+    last |= (uint64_t)bytes[8 * num_words + i] << (8 * i);
+  }
+  v3 ^= last;
+  SIP_ROUND(v0, v1, v2, v3);
+  SIP_ROUND(v0, v1, v2, v3);
+  v0 ^= last;
+
+  v2 ^= 0xff;
+  for (int i = 0; i < 4; i++) {
+    SIP_ROUND(v0, v1, v2, v3);
+  }
+  return v0 ^ v1 ^ v2 ^ v3;
+}
+
+void init_fast_open_key(uint64_t key[2]) {
+  if (getrandom(key, 2 * sizeof(uint64_t), 0) == 2 * sizeof(uint64_t)) {
+    return;
+  }
+  // without a random source the key is at least different for every run
+  key[0] = get_time_us() * 0x9E3779B97F4A7C15ULL;
+  key[1] = ((uint64_t)getpid() << 32) ^ (uintptr_t)key;
+}
+
+int load_fast_open_key(const char *path, uint64_t key[2]) {
+  FILE *file = fopen(path, "r");
+  if (file != NULL) {
+    int num_read = fscanf(file, "%" SCNx64 " %" SCNx64, &key[0], &key[1]);
+    fclose(file);
+    return num_read == 2 ? 0 : -1;
+  }
+
+  char tmp_path[4096];
+  if (snprintf(tmp_path, sizeof(tmp_path), "%s.XXXXXX", path) >=
+      (int)sizeof(tmp_path)) {
+    return -1;
+  }
+  // mkstemp creates the file readable by its owner only
+  int tmp_desc = mkstemp(tmp_path);
+  if (tmp_desc < 0) {
+    return -1;
+  }
+  FILE *tmp_file = fdopen(tmp_desc, "w");
+  if (tmp_file == NULL) {
+    close(tmp_desc);
+    unlink(tmp_path);
+    return -1;
+  }
+
+  init_fast_open_key(key);
+  fprintf(tmp_file, "%016" PRIx64 " %016" PRIx64 "\n", key[0], key[1]);
+  if (fclose(tmp_file) != 0 || rename(tmp_path, path) < 0) {
+    unlink(tmp_path);
+    return -1;
+  }
+  return 0;
+}
+
+uint64_t make_fast_open_cookie(const uint64_t key[2],
+                               struct sockaddr_in *client_addr) {
+  uint64_t cookie = siphash24(key, &client_addr->sin_addr.s_addr,
+                              sizeof(client_addr->sin_addr.s_addr));
+  return cookie != 0 ? cookie : 1;
+}
+
+uint32_t make_connection_isn(const uint64_t key[2],
+                             struct sockaddr_in *client_addr) {
+  // the clock makes every connection from the same port get another number
+  uint64_t input[2] = {get_time_us(),
+                       ((uint64_t)client_addr->sin_addr.s_addr << 16) |
+                           client_addr->sin_port};
+  uint32_t isn = (uint32_t)siphash24(key, input, sizeof(input));
+  return isn != 0 ? isn : 1;
+}
+
+int load_fast_open_cookie(const char *path, struct sockaddr_in *server_addr,
+                          fast_open_cookie_t *cookie) {
+  FILE *file = fopen(path, "r");
+  if (file == NULL) {
+    return 0;
+  }
+
+  char server_ip[INET_ADDRSTRLEN];
+  inet_ntop(AF_INET, &server_addr->sin_addr, server_ip, sizeof(server_ip));
+
+  char line[128];
+  char ip[INET_ADDRSTRLEN];
+  unsigned int port;
+  uint64_t value;
+  unsigned int segment_size;
+  int found = 0;
+  while (fgets(line, sizeof(line), file) != NULL) {
+    if (sscanf(line, "%15s %u %" SCNx64 " %u", ip, &port, &value,
+               &segment_size) == 4 &&
+        strcmp(ip, server_ip) == 0 && port == ntohs(server_addr->sin_port) &&
+        value != 0) {
+      cookie->cookie = value;
+      cookie->segment_size = segment_size;
+      found = 1;
+    }
+  }
+  fclose(file);
+  return found;
+}
+
+int store_fast_open_cookie(const char *path, struct sockaddr_in *server_addr,
+                           fast_open_cookie_t *cookie) {
+  char tmp_path[4096];
+  if (snprintf(tmp_path, sizeof(tmp_path), "%s.XXXXXX", path) >=
+      (int)sizeof(tmp_path)) {
+    return -1;
+  }
+  int tmp_desc = mkstemp(tmp_path);
+  if (tmp_desc < 0) {
+    return -1;
+  }
+  FILE *tmp_file = fdopen(tmp_desc, "w");
+  if (tmp_file == NULL) {
+    close(tmp_desc);
+    unlink(tmp_path);
+    return -1;
+  }
+
+  char server_ip[INET_ADDRSTRLEN];
+  inet_ntop(AF_INET, &server_addr->sin_addr, server_ip, sizeof(server_ip));
+  unsigned int server_port = ntohs(server_addr->sin_port);
+
+  // the cookies of the other receivers are copied over
+  FILE *file = fopen(path, "r");
+  if (file != NULL) {
+    char line[128];
+    char ip[INET_ADDRSTRLEN];
+    unsigned int port;
+    while (fgets(line, sizeof(line), file) != NULL) {
+      if (sscanf(line, "%15s %u", ip, &port) == 2 &&
+          (strcmp(ip, server_ip) != 0 || port != server_port)) {
+        fputs(line, tmp_file);
+      }
+    }
+    fclose(file);
+  }
+  fprintf(tmp_file, "%s %u %016" PRIx64 " %u\n", server_ip, server_port,
+          cookie->cookie, cookie->segment_size);
+
+  if (fclose(tmp_file) != 0 || rename(tmp_path, path) < 0) {
+    unlink(tmp_path);
+    return -1;
+  }
+  return 0;
+}
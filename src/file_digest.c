@@ -0,0 +1,150 @@
+/**
+ * @file file_digest.c
+ * @brief Function definitions for the digest of a transferred file
+ *
+ * This file contains the function definitions for XXH64, a fast
+ * non-cryptographic 64 bit hash that can be computed over a stream of bytes,
+ * and for the digest of a file built from it.
+ *
+ * https://github.com/Cyan4973/xxHash/blob/dev/doc/xxhash_spec.md
+ *
+ * @author Ritam Singal (ritamsingal)
+ * @author Harshil Patel (harshil-patel11)
+ * @bug No known bugs
+ */
+
+#include <endian.h>
+#include <string.h>
+
+#include "../include/file_digest.h"
+
+#define XXH_PRIME64_1 0x9E3779B185EBCA87ULL
+#define XXH_PRIME64_2 0xC2B2AE3D27D4EB4FULL
+#define XXH_PRIME64_3 0x165667B19E3779F9ULL
+#define XXH_PRIME64_4 0x85EBCA77C2B2AE63ULL
+#define XXH_PRIME64_5 0x27D4EB2F165667C5ULL
+
+#define XXH_ROTL64(x, r) (((x) << (r)) | ((x) >> (64 - (r))))
+
+// one 8 byte lane of a stripe is mixed into its accumulator
+#define XXH64_ROUND(acc, input)                                                \
+  XXH_ROTL64((acc) + (input) * XXH_PRIME64_2, 31) * XXH_PRIME64_1
+
+void xxh64_init(xxh64_state_t *state, uint64_t seed) {
+  memset(state, 0, sizeof(*state));
+  state->seed = seed;
+  state->lanes[0] = seed + XXH_PRIME64_1 + XXH_PRIME64_2;
+  state->lanes[1] = seed + XXH_PRIME64_2;
+  state->lanes[2] = seed;
+  state->lanes[3] = seed - XXH_PRIME64_1;
+}
+
+void xxh64_update(xxh64_state_t *state, const void *data, size_t len) {
+  const unsigned char *bytes = data;
+  state->total_len += len;
+
+  // a stripe started by the previous call is completed first
+  if (state->buf_len > 0) {
+    size_t fill = sizeof(state->buf) - state->buf_len;
+    if (len < fill) {
+      memcpy(state->buf + state->buf_len, bytes, len);
+      state->buf_len += len;
+      return;
+    }
+    memcpy(state->buf + state->buf_len, bytes, fill);
+    for (int i = 0; i < 4; i++) {
+      uint64_t lane;
+      memcpy(&lane, state->buf + 8 * i, sizeof(lane));
+      state->lanes[i] = XXH64_ROUND(state->lanes[i], le64toh(lane));
+    }
+    state->buf_len = 0;
+    bytes += fill;
+    len -= fill;
+  }
+
+  // the accumulators stay in registers while whole stripes are mixed in
+  uint64_t acc0 = state->lanes[0];
+  uint64_t acc1 = state->lanes[1];
+  uint64_t acc2 = state->lanes[2];
+  uint64_t acc3 = state->lanes[3];
+  while (len >= 32) {
+    uint64_t stripe[4];
+    memcpy(stripe, bytes, sizeof(stripe));
+    acc0 = XXH64_ROUND(acc0, le64toh(stripe[0]));
+    acc1 = XXH64_ROUND(acc1, le64toh(stripe[1]));
+    acc2 = XXH64_ROUND(acc2, le64toh(stripe[2]));
+    acc3 = XXH64_ROUND(acc3, le64toh(stripe[3]));
+    bytes += 32;
+    len -= 32;
+  }
+  state->lanes[0] = acc0;
+  state->lanes[1] = acc1;
+  state->lanes[2] = acc2;
+  state->lanes[3] = acc3;
+
+  memcpy(state->buf, bytes, len);
+  state->buf_len = len;
+}
+
+uint64_t xxh64_digest(const xxh64_state_t *state) {
+  uint64_t hash;
+  if (state->total_len >= 32) {
+    const uint64_t *lanes = state->lanes;
+    hash = XXH_ROTL64(lanes[0], 1) + XXH_ROTL64(lanes[1], 7) +
+           XXH_ROTL64(lanes[2], 12) + XXH_ROTL64(lanes[3], 18);
+    for (int i = 0; i < 4; i++) {
+      hash ^= XXH64_ROUND(0, lanes[i]);
+      hash = hash * XXH_PRIME64_1 + XXH_PRIME64_4;
+    }
+  } else {
+    hash = state->seed + XXH_PRIME64_5;
+  }
+  hash += state->total_len;
+
+  const unsigned char *bytes = state->buf;
+  size_t len = state->buf_len;
+  while (len >= 8) {
+    uint64_t lane;
+    memcpy(&lane, bytes, sizeof(lane));
+    hash ^= XXH64_ROUND(0, le64toh(lane));
+    hash = XXH_ROTL64(hash, 27) * XXH_PRIME64_1 + XXH_PRIME64_4;
+    bytes += 8;
+    len -= 8;
+  }
+  if (len >= 4) {
+    uint32_t word;
+    memcpy(&word, bytes, sizeof(word));
+    hash ^= (uint64_t)le32toh(word) * XXH_PRIME64_1;
+    hash = XXH_ROTL64(hash, 23) * XXH_PRIME64_2 + XXH_PRIME64_3;
+    bytes += 4;
+    len -= 4;
+  }
+  while (len > 0) {
+    hash ^= *bytes * XXH_PRIME64_5;
+    hash = XXH_ROTL64(hash, 11) * XXH_PRIME64_1;
+    bytes++;
+    len--;
+  }
+
+  hash ^= hash >> 33;
+  hash *= XXH_PRIME64_2;
+  hash ^= hash >> 29;
+  hash *= XXH_PRIME64_3;
+  hash ^= hash >> 32;
+  return hash;
+}
+
+uint64_t xxh64(const void *data, size_t len, uint64_t seed) {
+  xxh64_state_t state;
+  xxh64_init(&state, seed);
+  xxh64_update(&state, data, len);
+  return xxh64_digest(&state);
+}
+
+void init_file_digest(xxh64_state_t *digest) { xxh64_init(digest, 0); }
+
+void add_segment_hash(xxh64_state_t *digest, uint64_t segment_hash) {
+  // the hashes are added in little-endian order on every host
+  uint64_t bytes = htole64(segment_hash);
+  xxh64_update(digest, &bytes, sizeof(bytes));
+}
@@ -4,12 +4,12 @@
  * @brief Function definitions for receiving data from the sender
  *
  * This file contains the function definitions for receiving data from the
- * sender and writing it to a file, flushing data to file, sending an ACK to the
- * sender, establishing a connection with the sender, and closing the connection
- * with the sender.
+ * sender from an event loop and writing each segment at its offset in a file,
+ * sending an ACK to the sender, establishing a connection with the sender, and
+ * closing the connection with the sender.
  *
- * The main() function runs the receiver and listens for incoming packets from
- * the sender. It then writes the data to a file.
+ * The main() function of the receiver lives in receiver_main.c, so this file
+ * can be part of libtcpudp.
  *
  * @author Ritam Singal (ritamsingal)
  * @author Harshil Patel (harshil-patel11)
@@ -17,6 +17,7 @@
  */
 
 #include <arpa/inet.h>
+#include <limits.h>
 #include <netinet/in.h>
 #include <stdio.h>
 #include <stdlib.h>
@@ -27,16 +28,42 @@
 #include <unistd.h>
 
 #include <errno.h>
+#include <fcntl.h>
 #include <pthread.h>
 
+#include "../include/fast_open.h"
 #include "../include/receiver.h"
+#include "../include/tcp_io.h"
 #include "../include/tcp_segment.h"
 #include "../include/tcp_utils.h"
 #include "../include/utils.h"
 
-// https://www.educative.io/answers/how-to-implement-udp-sockets-in-c
+void init_receiver_options(receiver_options_t *options) {
+  options->ack_every = DEFAULT_ACK_EVERY;
+  options->ack_delay_us = DEFAULT_ACK_DELAY_US;
+  options->window_segments = DEFAULT_RECEIVE_WINDOW;
+  options->max_segment_size = MAX_SEGMENT_DATA_SIZE;
+  options->offload = 0;
+  options->io_engine = IO_ENGINE_MMSG;
+  options->server = 0;
+  options->max_connections = DEFAULT_MAX_CONNECTIONS;
+  options->num_workers = 1;
+  options->stream = 0;
+  init_fast_open_key(options->cookie_key);
+  options->cookie_key_file = NULL;
+}
+
 void rrecv(unsigned short int myUDPport, char *destinationFile,
            unsigned long long int writeRate) {
+  receiver_options_t options;
+  init_receiver_options(&options);
+  rrecv_with_options(myUDPport, destinationFile, writeRate, &options);
+}
+
+// https://www.educative.io/answers/how-to-implement-udp-sockets-in-c
+int rrecv_with_options(unsigned short int myUDPport, char *destinationFile,
+                       unsigned long long int writeRate,
+                       receiver_options_t *options) {
 
   char *ip;
   if (get_host_ip(&ip) < 0) {
@@ -45,194 +72,965 @@ void rrecv(unsigned short int myUDPport, char *destinationFile,
   }
   printf("Host IP: %s\n", ip);
 
-  FILE *output_file = fopen(destinationFile, "w");
-  if (output_file == NULL) {
-    printf("Couldn't open file\n");
+  if (options->cookie_key_file != NULL &&
+      load_fast_open_key(options->cookie_key_file, options->cookie_key) < 0) {
+    printf("Couldn't load the fast open key\n");
+    return -1;
+  }
+
+  // in server mode each transfer opens its own file once its SYN arrives
+  FILE *output_file = NULL;
+  if (!options->server) {
+    output_file = fopen(destinationFile, "w");
+    if (output_file == NULL) {
+      printf("Couldn't open file\n");
+      return -1;
+    }
+  }
+
+  // only a server spreads its senders over several workers
+  uint32_t num_workers = options->server ? options->num_workers : 1;
+  receiver_state_t *workers = calloc(num_workers, sizeof(receiver_state_t));
+  if (workers == NULL) {
+    printf("Couldn't allocate workers\n");
+    if (output_file != NULL) {
+      fclose(output_file);
+    }
     return -1;
   }
 
+  // all workers write from one bucket, so the rate is the total
+  write_bucket_t write_bucket = {.rate = writeRate, .time_us = get_time_us()};
+  pthread_mutex_init(&write_bucket.lock, NULL);
+
+  // the kernel spreads the senders evenly on average, so each worker serves
+  // its share of the connections
+  uint32_t max_connections =
+      options->server
+          ? (options->max_connections + num_workers - 1) / num_workers
+          : 1;
+  for (uint32_t i = 0; i < num_workers; i++) {
+    workers[i].options = options;
+    workers[i].port = myUDPport;
+    workers[i].ip = ip;
+    workers[i].max_connections = max_connections;
+    workers[i].filename = destinationFile;
+    workers[i].write_bucket = writeRate > 0 ? &write_bucket : NULL;
+  }
+  workers[0].output_file = output_file;
+
+  // the calling thread runs the first worker
+  uint32_t num_started = 1;
+  while (num_started < num_workers) {
+    if (pthread_create(&workers[num_started].thread, NULL, receiver_worker,
+                       &workers[num_started]) != 0) {
+      printf("Couldn't start worker thread\n");
+      break;
+    }
+    num_started++;
+  }
+
+  int retval = run_receiver(&workers[0]);
+  for (uint32_t i = 1; i < num_started; i++) {
+    pthread_join(workers[i].thread, NULL);
+    if (workers[i].retval < 0) {
+      retval = -1;
+    }
+  }
+  pthread_mutex_destroy(&write_bucket.lock);
+  free(workers);
+  return retval;
+}
+
+int run_receiver(receiver_state_t *state) {
+  event_loop_t loop;
+  if (start_receiver(state, &loop) < 0) {
+    return -1;
+  }
+  int loop_retval = run_event_loop(&loop);
+  stop_receiver(state);
+  return loop_retval == EVENT_STOP ? 0 : -1;
+}
+
+int start_receiver(receiver_state_t *state, event_loop_t *loop) {
+  receiver_options_t *options = state->options;
+  FILE *output_file = state->output_file;
+
   int socket_desc = create_socket();
   if (socket_desc < 0) {
     printf("Error while creating socket\n");
-    fclose(output_file);
+    if (output_file != NULL) {
+      fclose(output_file);
+    }
+    return -1;
+  }
+
+  if (options->server && options->num_workers > 1 &&
+      set_socket_reuse_port(socket_desc) < 0) {
+    printf("Unable to share the port between workers\n");
+    close(socket_desc);
+    if (output_file != NULL) {
+      fclose(output_file);
+    }
     return -1;
   }
 
   struct sockaddr_in server_addr;
-  if (bind_socket(socket_desc, &server_addr, myUDPport, ip) < 0) {
+  if (bind_socket(socket_desc, &server_addr, state->port, state->ip) < 0) {
     printf("Unable to bind socket\n");
     close(socket_desc);
-    fclose(output_file);
+    if (output_file != NULL) {
+      fclose(output_file);
+    }
     return -1;
   }
   printf("Done with binding socket address to socket descriptor\n");
 
-  uint32_t last_flushed_seq = 0;
-  int file_buffer_seq[MAX_WINDOW_SIZE];
-  memset(file_buffer_seq, 0, sizeof(file_buffer_seq));
-  char file_buffer[SEGMENT_DATA_SIZE * MAX_WINDOW_SIZE];
-  memset(file_buffer, '\0', sizeof(file_buffer));
-
-  while (1) {
-    tcp_segment_t client_segment;
-    struct sockaddr_in client_addr;
-    int client_addr_size = sizeof(client_addr);
-
-    int recv_retval = recv_tcp(socket_desc, &client_addr, &client_segment);
-    if (recv_retval == RECV_FAILED) {
-      printf("Unable to receive packet\n");
-      close(socket_desc);
+  state->socket_desc = socket_desc;
+  state->loop = loop;
+
+  if (init_tcp_io(&state->io, socket_desc, IO_BATCH_SIZE, options->offload,
+                  options->io_engine) < 0) {
+    printf("Couldn't allocate receive batch\n");
+    close(socket_desc);
+    if (output_file != NULL) {
+      fclose(output_file);
+    }
+    return -1;
+  }
+
+  if (init_event_loop(loop) < 0 ||
+      add_event_source(loop, &state->socket_source, socket_desc, EPOLLIN,
+                       handle_receiver_socket, state) < 0) {
+    printf("Couldn't create event loop\n");
+    free_event_loop(loop);
+    free_tcp_io(&state->io);
+    close(socket_desc);
+    if (output_file != NULL) {
       fclose(output_file);
-      return -1;
     }
+    return -1;
+  }
+
+  return 0;
+}
+
+void stop_receiver(receiver_state_t *state) {
+  for (int i = 0; i < CONNECTION_TABLE_SIZE; i++) {
+    while (state->connections[i] != NULL) {
+      free_connection(state, state->connections[i]);
+    }
+  }
+  free_event_loop(state->loop);
+  free_tcp_io(&state->io);
+  close(state->socket_desc);
+  if (state->output_file != NULL) {
+    fclose(state->output_file);
+    state->output_file = NULL;
+  }
+}
+
+void *receiver_worker(void *arg) {
+  receiver_state_t *state = arg;
+  state->retval = run_receiver(state);
+  return NULL;
+}
+
+int handle_receiver_socket(void *context, uint32_t events) {
+  receiver_state_t *state = context;
+  (void)events;
+  int recv_retval = recv_tcp_batch(&state->io, 0);
+  if (recv_retval == WRITE_FAILED) {
+    printf("Couldn't write to file\n");
+    return WRITE_FAILED;
+  } else if (recv_retval == RECV_FAILED || recv_retval == UNKNOWN_FAILURE) {
+    printf("Unable to receive packet\n");
+    return recv_retval;
+  }
 
-    if (client_segment.flags == SYN) {
-      printf("Received SYN\n");
-      if (establish_connection_receiver(socket_desc, &client_addr) != SUCCESS) {
-        printf("Unable to send SYN-ACK\n");
-        close(socket_desc);
-        fclose(output_file);
-        return -1;
+  tcp_segment_t client_segment;
+  struct sockaddr_in client_addr;
+  while (next_tcp_segment(&state->io, &client_segment, &client_addr)) {
+    int retval = process_segment(state, &client_segment, &client_addr);
+    if (retval != EVENT_CONTINUE) {
+      return retval;
+    }
+  }
+  return EVENT_CONTINUE;
+}
+
+int handle_connection_timer(void *context, uint32_t events) {
+  connection_t *connection = context;
+  (void)events;
+  receiver_state_t *state = connection->receiver;
+  if (connection->closed) {
+    free_connection(state, connection);
+    return EVENT_CONTINUE;
+  }
+
+  uint64_t now = get_time_us();
+  receive_buffer_t *file_buffer = &connection->file_buffer;
+  if (connection->write_deadline_us != 0 &&
+      connection->write_deadline_us <= now) {
+    int write_retval = write_connection_data(connection);
+    if (write_retval == SUCCESS && connection->fin_pending &&
+        file_buffer->read_seq == file_buffer->base_seq &&
+        close_connection(connection, CONNECTION_LINGER_US) < 0) {
+      write_retval = WRITE_FAILED;
+    }
+    if (write_retval != SUCCESS) {
+      printf("Couldn't write to file\n");
+      // the sender waits for the FIN-ACK, and learns of the failure instead
+      if (connection->fin_pending &&
+          reset_connection_receiver(state->socket_desc, &connection->addr,
+                                    connection->ts_recent,
+                                    RST_REASON_WRITE_FAILED) != SUCCESS) {
+        printf("Unable to send RST\n");
       }
-    } else if (client_segment.flags == FIN) {
-      printf("Received FIN\n");
-      if (close_connection_receiver(socket_desc, &client_addr) != SUCCESS) {
+      return fail_connection(connection, write_retval);
+    }
+    // the FIN was acknowledged already, the FIN-ACK follows once the last
+    // segment is written and the file is closed
+    if (connection->closed) {
+      state->num_closed_streams++;
+      if (close_connection_receiver(state->socket_desc, &connection->addr,
+                                    connection->ts_recent) != SUCCESS) {
         printf("Unable to send FIN-ACK\n");
-        close(socket_desc);
-        fclose(output_file);
-        return -1;
+        return fail_connection(connection, SEND_FAILED);
       }
-      flush_packets_to_file(output_file, file_buffer, file_buffer_seq);
-      break;
-    } else {
-      int flush = process_data(socket_desc, &client_segment, &client_addr,
-                               file_buffer, file_buffer_seq, last_flushed_seq);
-      if (flush == 1) {
-        int num_packets_flushed =
-            flush_packets_to_file(output_file, file_buffer, file_buffer_seq);
-        last_flushed_seq += num_packets_flushed;
-      }
-
-      // send ACK only if we can buffer the data
-      if (client_segment.seq_number < last_flushed_seq + MAX_WINDOW_SIZE) {
-        if (send_ack(socket_desc, &client_segment, &client_addr) != SUCCESS) {
-          printf("Unable to send ACK\n");
-          close(socket_desc);
-          fclose(output_file);
-          return -1;
+      return state->options->server ||
+                     state->num_closed_streams < state->num_streams
+                 ? EVENT_CONTINUE
+                 : EVENT_STOP;
+    }
+  }
+
+  // the delayed ACK timer fired
+  if (connection->ack_deadline_us != 0 && connection->ack_deadline_us <= now) {
+    connection->ack_deadline_us = 0;
+    if (connection->pending_acks > 0) {
+      connection->pending_acks = 0;
+      if (send_ack(state->socket_desc, &connection->addr, file_buffer,
+                   connection->ts_recent) != SUCCESS) {
+        printf("Unable to send ACK\n");
+        return fail_connection(connection, SEND_FAILED);
+      }
+    }
+  }
+
+  if (arm_connection_timer(connection) < 0) {
+    printf("Couldn't arm connection timer\n");
+    return fail_connection(connection, UNKNOWN_FAILURE);
+  }
+  return EVENT_CONTINUE;
+}
+
+int process_segment(receiver_state_t *state, tcp_segment_t *client_segment,
+                    struct sockaddr_in *client_addr) {
+  receiver_options_t *options = state->options;
+  connection_t *connection = find_connection(state, client_addr);
+
+  if (client_segment->flags == SYN) {
+    printf("Received SYN\n");
+    syn_options_t syn_options = {.segment_size = MIN_SEGMENT_DATA_SIZE};
+    read_syn_options(client_segment, &syn_options);
+    // a sender asking for a cookie or presenting one gets the current one
+    uint64_t cookie = 0;
+    if (syn_options.fast_open) {
+      cookie = make_fast_open_cookie(options->cookie_key, client_addr);
+    }
+    // a retransmitted SYN is answered with the segment size of the first
+    if (connection == NULL) {
+      // data sent behind the SYN is only taken if it needs no renegotiation
+      int fast_open = syn_options.fast_open && syn_options.cookie == cookie &&
+                      syn_options.segment_size >= MIN_SEGMENT_DATA_SIZE &&
+                      syn_options.segment_size <= options->max_segment_size &&
+                      syn_options.checksum_type <= CHECKSUM_CRC32C;
+      syn_options.segment_size =
+          MAX(MIN(syn_options.segment_size, options->max_segment_size),
+              MIN_SEGMENT_DATA_SIZE);
+      // a checksum this receiver does not know is not accepted
+      if (syn_options.checksum_type > CHECKSUM_CRC32C) {
+        syn_options.checksum_type = CHECKSUM_INTERNET;
+      }
+      connection = open_connection(state, client_addr, &syn_options);
+      if (connection == NULL) {
+        return EVENT_CONTINUE;
+      }
+      connection->fast_open = fast_open;
+      printf("Segment size: %d bytes\n", syn_options.segment_size);
+      if (fast_open) {
+        printf("Fast open cookie accepted\n");
+      }
+    }
+    if (connection->closed) {
+      return EVENT_CONTINUE;
+    }
+    if (establish_connection_receiver(
+            state->socket_desc, client_addr, client_segment->ts_val,
+            &connection->file_buffer, connection->checksum_type,
+            connection->isn, cookie) != SUCCESS) {
+      printf("Unable to send SYN-ACK\n");
+      return fail_connection(connection, SEND_FAILED);
+    }
+  } else if (connection == NULL) {
+    // nothing is accepted before the connection is established
+    return EVENT_CONTINUE;
+  } else if (client_segment->flags == FIN) {
+    printf("Received FIN\n");
+    // the FIN-ACK is only sent once every segment reached the file, a rate
+    // limited writer that still holds some acknowledges the FIN instead and
+    // sends the FIN-ACK once they are written
+    receive_buffer_t *file_buffer = &connection->file_buffer;
+    if (!connection->closed && !connection->fin_pending) {
+      connection->digest_mismatch =
+          !check_file_digest(file_buffer, client_segment);
+      connection->fin_pending = !connection->digest_mismatch &&
+                                file_buffer->file_desc >= 0 &&
+                                file_buffer->read_seq != file_buffer->base_seq;
+      if (!connection->fin_pending) {
+        if (close_connection(connection, CONNECTION_LINGER_US) < 0) {
+          printf("Couldn't write to file\n");
+          return fail_connection(connection, WRITE_FAILED);
+        }
+        state->num_closed_streams++;
+      }
+    }
+    // a retransmitted FIN is rejected again while the connection lingers
+    if (connection->digest_mismatch) {
+      printf("File digest mismatch\n");
+      if (reset_connection_receiver(state->socket_desc, client_addr,
+                                    client_segment->ts_val,
+                                    RST_REASON_DIGEST_MISMATCH) != SUCCESS) {
+        printf("Unable to send RST\n");
+        return fail_connection(connection, SEND_FAILED);
+      }
+      return fail_connection(connection, DIGEST_MISMATCH);
+    }
+    // a connection that failed never confirms the file
+    if (connection->error != SUCCESS) {
+      return EVENT_CONTINUE;
+    }
+    if (connection->fin_pending && !connection->closed) {
+      connection->ts_recent = client_segment->ts_val;
+      if (acknowledge_fin_receiver(state->socket_desc, client_addr,
+                                   client_segment->seq_number,
+                                   client_segment->ts_val) != SUCCESS) {
+        printf("Unable to send ACK\n");
+        return fail_connection(connection, SEND_FAILED);
+      }
+      return EVENT_CONTINUE;
+    }
+    if (close_connection_receiver(state->socket_desc, client_addr,
+                                  client_segment->ts_val) != SUCCESS) {
+      printf("Unable to send FIN-ACK\n");
+      return fail_connection(connection, SEND_FAILED);
+    }
+    return options->server || state->num_closed_streams < state->num_streams
+               ? EVENT_CONTINUE
+               : EVENT_STOP;
+  } else if (!connection->closed) {
+    // without a valid cookie only segments echoing the SYN-ACK are taken, so
+    // a sender has to receive at its address before it can write the file
+    if (!connection->fast_open &&
+        client_segment->ack_number != connection->isn) {
+      return EVENT_CONTINUE;
+    }
+    receive_buffer_t *file_buffer = &connection->file_buffer;
+    // segments that arrive out of order, and segments that fill a hole, are
+    // acknowledged right away so the sender learns about the hole quickly
+    int ack_now = client_segment->seq_number != file_buffer->base_seq ||
+                  has_out_of_order_segments(file_buffer);
+
+    // a segment beyond the buffer is not taken, but the sender learns right
+    // away how much room is left
+    if (client_segment->seq_number - file_buffer->read_seq >=
+            file_buffer->num_segments &&
+        (int32_t)(client_segment->seq_number - file_buffer->base_seq) >= 0) {
+      if (send_ack(state->socket_desc, client_addr, file_buffer,
+                   client_segment->ts_val) != SUCCESS) {
+        printf("Unable to send ACK\n");
+        return fail_connection(connection, SEND_FAILED);
+      }
+      return EVENT_CONTINUE;
+    }
+
+    if (process_data(file_buffer, client_segment) < 0) {
+      printf("Couldn't write to file\n");
+      return fail_connection(connection, WRITE_FAILED);
+    }
+    advance_receive_buffer(file_buffer);
+
+    // an idle rate limited writer starts on the new data, a busy one wakes up
+    // on its own
+    if (file_buffer->file_desc >= 0 && file_buffer->data != NULL &&
+        connection->write_deadline_us == 0) {
+      int write_retval = write_connection_data(connection);
+      if (write_retval != SUCCESS) {
+        printf("Couldn't write to file\n");
+        return fail_connection(connection, write_retval);
+      }
+      if (connection->write_deadline_us != 0 &&
+          arm_connection_timer(connection) < 0) {
+        printf("Couldn't arm connection timer\n");
+        return fail_connection(connection, UNKNOWN_FAILURE);
+      }
+    }
+
+    connection->pending_acks++;
+    if (connection->pending_acks == 1) {
+      // echo the oldest unacknowledged segment, so the sender's RTT samples
+      // include the time the ACK was delayed
+      connection->ts_recent = client_segment->ts_val;
+      // a timer that is still armed fires early, which only sends the ACK
+      // sooner than necessary
+      uint64_t now = get_time_us();
+      if (connection->ack_deadline_us <= now) {
+        connection->ack_deadline_us = now + options->ack_delay_us;
+        if (arm_connection_timer(connection) < 0) {
+          printf("Couldn't arm ACK timer\n");
+          return fail_connection(connection, UNKNOWN_FAILURE);
         }
       }
     }
+    if (ack_now || connection->pending_acks >= options->ack_every) {
+      connection->pending_acks = 0;
+      if (send_ack(state->socket_desc, client_addr, file_buffer,
+                   connection->ts_recent) != SUCCESS) {
+        printf("Unable to send ACK\n");
+        return fail_connection(connection, SEND_FAILED);
+      }
+    }
   }
+  return EVENT_CONTINUE;
+}
 
-  close(socket_desc);
-  fclose(output_file);
-  return 0;
+uint32_t connection_bucket(struct sockaddr_in *client_addr) {
+  uint32_t hash = (client_addr->sin_addr.s_addr ^ client_addr->sin_port) *
+                  2654435761u; // Knuth's multiplicative hash
+  return (hash >> 16) % CONNECTION_TABLE_SIZE;
 }
 
-int process_data(int socket_desc, tcp_segment_t *client_segment,
-                 struct sockaddr_in *client_addr, char *file_buffer,
-                 int *file_buffer_seq, uint32_t last_flushed_seq) {
+connection_t *find_connection(receiver_state_t *state,
+                              struct sockaddr_in *client_addr) {
+  // the segments of a batch mostly come from the same sender
+  connection_t *connection = state->last_connection;
+  if (connection == NULL ||
+      connection->addr.sin_addr.s_addr != client_addr->sin_addr.s_addr ||
+      connection->addr.sin_port != client_addr->sin_port) {
+    connection = state->connections[connection_bucket(client_addr)];
+    while (connection != NULL &&
+           (connection->addr.sin_addr.s_addr != client_addr->sin_addr.s_addr ||
+            connection->addr.sin_port != client_addr->sin_port)) {
+      connection = connection->next;
+    }
+  }
+  if (connection != NULL) {
+    state->last_connection = connection;
+  }
+  return connection;
+}
 
-  if (client_segment->seq_number < last_flushed_seq + MAX_WINDOW_SIZE &&
-      client_segment->seq_number >= last_flushed_seq) {
-    memcpy(file_buffer + SEGMENT_DATA_SIZE *
-                             (client_segment->seq_number - last_flushed_seq),
-           client_segment->data, SEGMENT_DATA_SIZE);
+connection_t *open_connection(receiver_state_t *state,
+                              struct sockaddr_in *client_addr,
+                              syn_options_t *syn_options) {
+  receiver_options_t *options = state->options;
+  int striped = syn_options->num_streams > 1;
+  // without -s only the streams of the first transfer are served
+  uint32_t max_connections = state->max_connections;
+  if (!options->server && state->num_streams > 0) {
+    if (!striped || syn_options->transfer_id != state->transfer_id) {
+      printf("Receiver is busy, SYN ignored\n");
+      return NULL;
+    }
+    max_connections = state->num_streams;
+  }
+  if (state->num_connections >= max_connections) {
+    printf("Connection table is full, SYN ignored\n");
+    return NULL;
+  }
+  // the stripes of a file only meet again in the file
+  if (options->stream && striped) {
+    printf("Striped transfers need a file, SYN ignored\n");
+    return NULL;
+  }
 
-    file_buffer_seq[client_segment->seq_number - last_flushed_seq] = 1;
+  connection_t *connection = calloc(1, sizeof(connection_t));
+  if (connection == NULL) {
+    printf("Couldn't allocate connection\n");
+    return NULL;
   }
+  connection->addr = *client_addr;
+  connection->receiver = state;
 
-  // check if we can flush to file
-  for (int i = 0; i < MAX_WINDOW_SIZE; i++) {
-    if (file_buffer_seq[i] == 0) {
-      return 0;
+  // the file opened for the only transfer is handed over once nothing fails
+  FILE *output_file = state->output_file;
+  if (output_file == NULL && !options->stream) {
+    char address[INET_ADDRSTRLEN];
+    char filename[PATH_MAX];
+    inet_ntop(AF_INET, &client_addr->sin_addr, address, sizeof(address));
+    if (!striped) {
+      snprintf(filename, sizeof(filename), "%s.%s.%d", state->filename,
+               address, ntohs(client_addr->sin_port));
+      output_file = fopen(filename, "w");
+    } else {
+      if (options->server) {
+        snprintf(filename, sizeof(filename), "%s.%s.%u", state->filename,
+                 address, syn_options->transfer_id);
+      } else {
+        snprintf(filename, sizeof(filename), "%s", state->filename);
+      }
+      // the other streams write to the same file, so it is not truncated
+      int file_desc = open(filename, O_RDWR | O_CREAT, 0644);
+      if (file_desc >= 0) {
+        output_file = fdopen(file_desc, "r+");
+        if (output_file == NULL) {
+          close(file_desc);
+        }
+      }
+    }
+    if (output_file == NULL) {
+      printf("Couldn't open file\n");
+      free(connection);
+      return NULL;
     }
   }
 
-  return 1;
+  // every stream sets the final size, which only drops stale bytes past it
+  if (striped &&
+      ftruncate(fileno(output_file), syn_options->total_bytes) < 0) {
+    printf("Couldn't size file\n");
+    if (output_file != state->output_file) {
+      fclose(output_file);
+    }
+    free(connection);
+    return NULL;
+  }
+  if (init_receive_buffer(&connection->file_buffer, options->window_segments,
+                          syn_options->segment_size,
+                          output_file != NULL ? fileno(output_file) : -1,
+                          state->write_bucket != NULL, &state->io) < 0) {
+    printf("Couldn't allocate receive buffer\n");
+    if (output_file != state->output_file) {
+      fclose(output_file);
+    }
+    free(connection);
+    return NULL;
+  }
+  if (init_event_timer(state->loop, &connection->timer,
+                       handle_connection_timer, connection) < 0) {
+    printf("Couldn't create ACK timer\n");
+    free_receive_buffer(&connection->file_buffer);
+    if (output_file != state->output_file) {
+      fclose(output_file);
+    }
+    free(connection);
+    return NULL;
+  }
+  connection->output_file = output_file;
+  connection->checksum_type = syn_options->checksum_type;
+  connection->isn = make_connection_isn(options->cookie_key, client_addr);
+  connection->file_buffer.file_offset = striped ? syn_options->offset : 0;
+  state->output_file = NULL;
+  if (!options->server && state->num_streams == 0) {
+    state->transfer_id = striped ? syn_options->transfer_id : 0;
+    state->num_streams = striped ? syn_options->num_streams : 1;
+  }
+
+  // the socket has to absorb bursts as large as the advertised windows
+  state->num_connections++;
+  set_socket_buffers(state->socket_desc,
+                     state->num_connections * options->window_segments *
+                         (sizeof(tcp_header_t) + syn_options->segment_size));
+
+  uint32_t bucket = connection_bucket(client_addr);
+  connection->next = state->connections[bucket];
+  state->connections[bucket] = connection;
+  if (options->stream) {
+    if (state->accept_tail != NULL) {
+      state->accept_tail->next_accept = connection;
+    } else {
+      state->accept_head = connection;
+    }
+    state->accept_tail = connection;
+  }
+  return connection;
+}
+
+int close_connection(connection_t *connection, uint64_t linger_us) {
+  connection->closed = 1;
+  // queued writes go to the descriptor that is about to be closed
+  int retval = sync_tcp_writes(&connection->receiver->io) == SUCCESS ? 0 : -1;
+  if (connection->output_file != NULL) {
+    fclose(connection->output_file);
+    connection->output_file = NULL;
+  }
+  // the application still reads the data of a stream, and frees it after
+  if (connection->file_buffer.file_desc < 0) {
+    arm_event_timer(&connection->timer, 0);
+    return retval;
+  }
+  free_receive_buffer(&connection->file_buffer);
+  arm_event_timer(&connection->timer, get_time_us() + linger_us);
+  return retval;
+}
+
+int arm_connection_timer(connection_t *connection) {
+  uint64_t deadline_us = connection->ack_deadline_us;
+  if (connection->write_deadline_us != 0 &&
+      (deadline_us == 0 || connection->write_deadline_us < deadline_us)) {
+    deadline_us = connection->write_deadline_us;
+  }
+  return arm_event_timer(&connection->timer, deadline_us);
+}
+
+int write_connection_data(connection_t *connection) {
+  receiver_state_t *state = connection->receiver;
+  receive_buffer_t *buffer = &connection->file_buffer;
+  write_bucket_t *bucket = state->write_bucket;
+  double rate = bucket->rate;
+
+  // credit saved up while the writers were idle is capped, so the writes
+  // after a pause stay a short burst
+  uint64_t now = get_time_us();
+  double max_credit = MAX(rate * WRITE_BURST_US / 1e6, buffer->segment_size);
+  pthread_mutex_lock(&bucket->lock);
+  if (now > bucket->time_us) {
+    bucket->credit =
+        MIN(bucket->credit + rate * (now - bucket->time_us) / 1e6, max_credit);
+    bucket->time_us = now;
+  }
+  double credit = bucket->credit;
+  pthread_mutex_unlock(&bucket->lock);
+
+  uint32_t window = advertised_window(buffer);
+  ssize_t num_written =
+      credit > 0 ? write_receive_buffer(buffer, (size_t)credit) : 0;
+  if (num_written < 0) {
+    return WRITE_FAILED;
+  }
+  pthread_mutex_lock(&bucket->lock);
+  bucket->credit -= num_written;
+  credit = bucket->credit;
+  pthread_mutex_unlock(&bucket->lock);
+
+  // the writer resumes once the credit pays for the next segment
+  connection->write_deadline_us = 0;
+  if (buffer->read_seq != buffer->base_seq) {
+    uint16_t len =
+        buffer->segment_lens[buffer->read_seq % buffer->num_segments];
+    uint64_t wait_us = (len - credit) * 1e6 / rate + 1;
+    connection->write_deadline_us = now + MAX(wait_us, WRITE_INTERVAL_US);
+  }
+
+  uint32_t half = buffer->num_segments / 2;
+  if (!connection->closed && window < half &&
+      advertised_window(buffer) >= half &&
+      send_ack(state->socket_desc, &connection->addr, buffer,
+               connection->ts_recent) != SUCCESS) {
+    return SEND_FAILED;
+  }
+  return SUCCESS;
 }
 
-int flush_packets_to_file(FILE *file, char *file_buffer, int *file_buffer_seq) {
-  int num_packets_to_flush = 0;
-  for (int i = 0; i < MAX_WINDOW_SIZE; i++) {
-    if (file_buffer_seq[i] == 0) {
+void free_connection(receiver_state_t *state, connection_t *connection) {
+  connection_t **link = &state->connections[connection_bucket(
+      &connection->addr)];
+  while (*link != connection) {
+    link = &(*link)->next;
+  }
+  *link = connection->next;
+  if (state->last_connection == connection) {
+    state->last_connection = NULL;
+  }
+  state->num_connections--;
+
+  connection_t *previous = NULL;
+  for (connection_t *queued = state->accept_head; queued != NULL;
+       queued = queued->next_accept) {
+    if (queued == connection) {
+      if (previous != NULL) {
+        previous->next_accept = connection->next_accept;
+      } else {
+        state->accept_head = connection->next_accept;
+      }
+      if (state->accept_tail == connection) {
+        state->accept_tail = previous;
+      }
       break;
     }
-    num_packets_to_flush++;
+    previous = queued;
   }
 
-  int trailing_nulls = 0;
-  for (int i = SEGMENT_DATA_SIZE - 1; i >= 0; i--) {
-    if (file_buffer[(num_packets_to_flush - 1) * SEGMENT_DATA_SIZE + i] ==
-        '\0') {
-      trailing_nulls++;
-    } else {
+  if (!connection->closed) {
+    sync_tcp_writes(&state->io);
+  }
+  if (connection->output_file != NULL) {
+    fclose(connection->output_file);
+  }
+  free_receive_buffer(&connection->file_buffer);
+  free_event_timer(state->loop, &connection->timer);
+  free(connection);
+}
+
+int fail_connection(connection_t *connection, int error) {
+  connection->error = error;
+  if (!connection->receiver->options->server) {
+    return error;
+  }
+  if (!connection->closed) {
+    close_connection(connection, 0);
+  }
+  return EVENT_CONTINUE;
+}
+
+int init_receive_buffer(receive_buffer_t *buffer, uint32_t num_segments,
+                        uint16_t segment_size, int file_desc, int hold_data,
+                        tcp_io_t *io) {
+  hold_data = hold_data || file_desc < 0;
+  buffer->seq_bitmap = calloc((num_segments + 63) / 64, sizeof(uint64_t));
+  buffer->segment_hashes = malloc(num_segments * sizeof(uint64_t));
+  buffer->data = NULL;
+  buffer->segment_lens = NULL;
+  if (hold_data) {
+    buffer->data = malloc((size_t)num_segments * segment_size);
+    buffer->segment_lens = malloc(num_segments * sizeof(uint16_t));
+  }
+  if (buffer->seq_bitmap == NULL || buffer->segment_hashes == NULL ||
+      (hold_data && (buffer->data == NULL || buffer->segment_lens == NULL))) {
+    free_receive_buffer(buffer);
+    return -1;
+  }
+  init_file_digest(&buffer->digest);
+  buffer->num_segments = num_segments;
+  buffer->segment_size = segment_size;
+  buffer->base_seq = 0;
+  buffer->end_seq = 0;
+  buffer->read_seq = 0;
+  buffer->read_offset = 0;
+  buffer->file_desc = file_desc;
+  buffer->file_offset = 0;
+  buffer->io = io;
+  return 0;
+}
+
+void free_receive_buffer(receive_buffer_t *buffer) {
+  free(buffer->seq_bitmap);
+  free(buffer->segment_hashes);
+  free(buffer->data);
+  free(buffer->segment_lens);
+  buffer->seq_bitmap = NULL;
+  buffer->segment_hashes = NULL;
+  buffer->data = NULL;
+  buffer->segment_lens = NULL;
+}
+
+int process_data(receive_buffer_t *buffer, tcp_segment_t *client_segment) {
+  uint32_t seq_number = client_segment->seq_number;
+  if ((int32_t)(seq_number - buffer->base_seq) < 0 ||
+      seq_number - buffer->read_seq >= buffer->num_segments ||
+      client_segment->data_len > buffer->segment_size ||
+      is_segment_received(buffer, seq_number)) {
+    return 0;
+  }
+
+  uint32_t slot = seq_number % buffer->num_segments;
+  if (buffer->data != NULL) {
+    memcpy(buffer->data + slot * (size_t)buffer->segment_size,
+           client_segment->data, client_segment->data_len);
+    buffer->segment_lens[slot] = client_segment->data_len;
+  } else {
+    // every segment but the last one carries a full segment_size of data
+    off_t offset =
+        buffer->file_offset + (off_t)seq_number * buffer->segment_size;
+    if (write_tcp_file(buffer->io, buffer->file_desc, client_segment->data,
+                       client_segment->data_len, offset) != SUCCESS) {
+      return -1;
+    }
+  }
+
+  buffer->seq_bitmap[slot / 64] |= (uint64_t)1 << (slot % 64);
+  buffer->segment_hashes[slot] =
+      xxh64(client_segment->data, client_segment->data_len, 0);
+  if ((int32_t)(seq_number + 1 - buffer->end_seq) > 0) {
+    buffer->end_seq = seq_number + 1;
+  }
+  return 0;
+}
+
+size_t read_receive_buffer(receive_buffer_t *buffer, char *data, size_t len) {
+  size_t num_read = 0;
+  while (num_read < len && buffer->read_seq != buffer->base_seq) {
+    uint32_t slot = buffer->read_seq % buffer->num_segments;
+    size_t chunk = MIN(buffer->segment_lens[slot] - buffer->read_offset,
+                       len - num_read);
+    memcpy(data + num_read,
+           buffer->data + slot * (size_t)buffer->segment_size +
+               buffer->read_offset,
+           chunk);
+    num_read += chunk;
+    buffer->read_offset += chunk;
+    if (buffer->read_offset == buffer->segment_lens[slot]) {
+      buffer->read_seq++;
+      buffer->read_offset = 0;
+    }
+  }
+  return num_read;
+}
+
+ssize_t write_receive_buffer(receive_buffer_t *buffer, size_t max_bytes) {
+  size_t num_written = 0;
+  while (buffer->read_seq != buffer->base_seq) {
+    uint32_t slot = buffer->read_seq % buffer->num_segments;
+    uint16_t len = buffer->segment_lens[slot];
+    if (num_written + len > max_bytes) {
       break;
     }
+    // the batch copies the payload, so the slot is free once it is queued
+    off_t offset =
+        buffer->file_offset + (off_t)buffer->read_seq * buffer->segment_size;
+    if (write_tcp_file(buffer->io, buffer->file_desc,
+                       buffer->data + slot * (size_t)buffer->segment_size,
+                       len, offset) != SUCCESS) {
+      return -1;
+    }
+    num_written += len;
+    buffer->read_seq++;
   }
+  return num_written;
+}
 
-  size_t bytes_written =
-      fwrite(file_buffer, 1,
-             num_packets_to_flush * SEGMENT_DATA_SIZE - trailing_nulls, file);
+int check_file_digest(receive_buffer_t *buffer, tcp_segment_t *fin_segment) {
+  uint64_t sent_digest;
+  if (!read_fin_digest(fin_segment, &sent_digest)) {
+    return 1;
+  }
+  return xxh64_digest(&buffer->digest) == sent_digest;
+}
+
+int is_segment_received(receive_buffer_t *buffer, uint32_t seq_number) {
+  uint32_t slot = seq_number % buffer->num_segments;
+  return (buffer->seq_bitmap[slot / 64] >> (slot % 64)) & 1;
+}
+
+int advance_receive_buffer(receive_buffer_t *buffer) {
+  int num_segments_advanced = 0;
+  while (num_segments_advanced < buffer->num_segments &&
+         is_segment_received(buffer, buffer->base_seq)) {
+    uint32_t slot = buffer->base_seq % buffer->num_segments;
+    buffer->seq_bitmap[slot / 64] &= ~((uint64_t)1 << (slot % 64));
+    add_segment_hash(&buffer->digest, buffer->segment_hashes[slot]);
+    buffer->base_seq++;
+    num_segments_advanced++;
+  }
+
+  if ((int32_t)(buffer->end_seq - buffer->base_seq) < 0) {
+    buffer->end_seq = buffer->base_seq;
+  }
+  // the segments of a file are on their way to it, nothing waits to be read
+  if (buffer->data == NULL) {
+    buffer->read_seq = buffer->base_seq;
+  }
+  return num_segments_advanced;
+}
 
-  memset(file_buffer_seq, 0, sizeof(int) * MAX_WINDOW_SIZE);
-  memset(file_buffer, '\0', sizeof(char) * SEGMENT_DATA_SIZE * MAX_WINDOW_SIZE);
+int has_out_of_order_segments(receive_buffer_t *buffer) {
+  return buffer->end_seq != buffer->base_seq;
+}
 
-  return num_packets_to_flush;
+uint32_t advertised_window(receive_buffer_t *buffer) {
+  return buffer->num_segments - (buffer->base_seq - buffer->read_seq);
 }
 
-tcp_error_t send_ack(int socket_desc, tcp_segment_t *client_segment,
-                     struct sockaddr_in *client_addr) {
+tcp_error_t send_ack(int socket_desc, struct sockaddr_in *client_addr,
+                     receive_buffer_t *buffer, uint32_t ts_ecr) {
 
   tcp_segment_t send_segment;
-  char server_message[10];
-  sprintf(server_message, "ACK: %d", client_segment->seq_number);
   create_tcp_segment(ntohs(client_addr->sin_port), ntohs(client_addr->sin_port),
-                     0, client_segment->seq_number, ACK, server_message,
-                     strlen(server_message), &send_segment);
+                     0, buffer->base_seq, ACK, NULL, 0, &send_segment);
+  fill_sack_blocks(&send_segment, buffer);
+  send_segment.window = advertised_window(buffer);
+  send_segment.ts_ecr = ts_ecr;
 
   return send_tcp(socket_desc, &send_segment, client_addr);
 }
 
+void fill_sack_blocks(tcp_segment_t *segment, receive_buffer_t *buffer) {
+  uint32_t seq = buffer->base_seq;
+  while (seq != buffer->end_seq && segment->num_sack_blocks < MAX_SACK_BLOCKS) {
+    if (!is_segment_received(buffer, seq)) {
+      seq++;
+      continue;
+    }
+
+    sack_block_t *block = &segment->sack_blocks[segment->num_sack_blocks++];
+    block->start = seq;
+    while (seq != buffer->end_seq && is_segment_received(buffer, seq)) {
+      seq++;
+    }
+    block->end = seq;
+  }
+}
+
 tcp_error_t establish_connection_receiver(int socket_desc,
-                                          struct sockaddr_in *client_addr) {
+                                          struct sockaddr_in *client_addr,
+                                          uint32_t ts_ecr,
+                                          receive_buffer_t *buffer,
+                                          checksum_type_t checksum_type,
+                                          uint32_t isn, uint64_t cookie) {
 
   tcp_segment_t send_segment;
-  char *server_message = "SYN-ACK";
+  syn_options_t syn_options = {.segment_size = buffer->segment_size,
+                               .checksum_type = checksum_type,
+                               .fast_open = cookie != 0,
+                               .cookie = cookie};
+  unsigned char server_message[sizeof(syn_options_t)];
+  size_t message_len = write_syn_options(&syn_options, server_message);
   create_tcp_segment(ntohs(client_addr->sin_port), ntohs(client_addr->sin_port),
-                     0, 0, SYN | ACK, server_message, strlen(server_message),
-                     &send_segment);
+                     isn, buffer->base_seq, SYN | ACK, server_message,
+                     message_len, &send_segment);
+  send_segment.window = advertised_window(buffer);
+  send_segment.ts_ecr = ts_ecr;
 
   printf("Receiver sending SYN-ACK\n");
   return send_tcp(socket_desc, &send_segment, client_addr);
 }
 
 tcp_error_t close_connection_receiver(int socket_desc,
-                                      struct sockaddr_in *client_addr) {
+                                      struct sockaddr_in *client_addr,
+                                      uint32_t ts_ecr) {
 
   tcp_segment_t send_segment;
   char *server_message = "FIN-ACK";
   create_tcp_segment(ntohs(client_addr->sin_port), ntohs(client_addr->sin_port),
-                     0, 0, FIN | ACK, server_message, strlen(server_message),
-                     &send_segment);
+                     0, 0, FIN | ACK, (unsigned char *)server_message,
+                     strlen(server_message), &send_segment);
+  send_segment.ts_ecr = ts_ecr;
 
   printf("Receiver sending FIN-ACK\n");
   return send_tcp(socket_desc, &send_segment, client_addr);
 }
 
-int main(int argc, char **argv) {
-  unsigned short int udp_port;
-  char *filename_to_write = NULL;
+tcp_error_t acknowledge_fin_receiver(int socket_desc,
+                                     struct sockaddr_in *client_addr,
+                                     uint32_t fin_seq, uint32_t ts_ecr) {
 
-  if (argc != 3) {
-    fprintf(stderr, "usage: %s UDP_port filename_to_write\n\n", argv[0]);
-    exit(1);
-  }
+  tcp_segment_t send_segment;
+  create_tcp_segment(ntohs(client_addr->sin_port), ntohs(client_addr->sin_port),
+                     0, fin_seq + 1, ACK, NULL, 0, &send_segment);
+  send_segment.ts_ecr = ts_ecr;
+  return send_tcp(socket_desc, &send_segment, client_addr);
+}
 
-  udp_port = (unsigned short int)atoi(argv[1]);
-  filename_to_write = argv[2];
+tcp_error_t reset_connection_receiver(int socket_desc,
+                                      struct sockaddr_in *client_addr,
+                                      uint32_t ts_ecr, uint8_t reason) {
 
-  rrecv(udp_port, filename_to_write, 0);
-  return (EXIT_SUCCESS);
+  tcp_segment_t send_segment;
+  create_tcp_segment(ntohs(client_addr->sin_port), ntohs(client_addr->sin_port),
+                     0, 0, RST, &reason, sizeof(reason), &send_segment);
+  send_segment.ts_ecr = ts_ecr;
+
+  printf("Receiver sending RST\n");
+  return send_tcp(socket_desc, &send_segment, client_addr);
 }
@@ -0,0 +1,123 @@
+/**
+ * @file receiver_main.c
+ *
+ * @brief Command line client that receives files with libtcpudp
+ *
+ * The main() function parses the options of the receiver and listens for
+ * incoming packets from senders with rrecv_with_options(). It then writes the
+ * data to a file. With -f it writes the files of sessions to a directory with
+ * receive_sessions().
+ *
+ * @author Ritam Singal (ritamsingal)
+ * @author Harshil Patel (harshil-patel11)
+ * @bug No known bugs
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include "../include/receiver.h"
+#include "../include/session.h"
+#include "../include/utils.h"
+
+int main(int argc, char **argv) {
+  unsigned short int udp_port;
+  char *filename_to_write = NULL;
+
+  receiver_options_t options;
+  init_receiver_options(&options);
+  int session = 0;
+  unsigned long long int write_rate = 0;
+
+  int opt;
+  while ((opt = getopt(argc, argv, "a:d:w:m:Oe:sn:t:fr:K:")) != -1) {
+    switch (opt) {
+    case 'a':
+      options.ack_every = MAX(1, atoi(optarg));
+      break;
+    case 'd':
+      options.ack_delay_us = atol(optarg);
+      break;
+    case 'w':
+      options.window_segments = MAX(1, atol(optarg));
+      break;
+    case 'm':
+      options.max_segment_size =
+          MAX(MIN(atol(optarg), MAX_SEGMENT_DATA_SIZE), MIN_SEGMENT_DATA_SIZE);
+      break;
+    case 'O':
+      options.offload = 1;
+      break;
+    case 'e':
+      if (parse_io_engine(optarg, &options.io_engine) < 0) {
+        fprintf(stderr, "unknown I/O engine: %s\n", optarg);
+        argc = 0;
+      }
+      break;
+    case 's':
+      options.server = 1;
+      break;
+    case 'n':
+      options.max_connections = MAX(1, atol(optarg));
+      break;
+    case 't':
+      options.num_workers = MAX(MIN(atol(optarg), MAX_RECEIVER_WORKERS), 1);
+      break;
+    case 'f':
+      session = 1;
+      break;
+    case 'r':
+      write_rate = strtoull(optarg, NULL, 10);
+      break;
+    case 'K':
+      options.cookie_key_file = optarg;
+      break;
+    default:
+      argc = 0;
+      break;
+    }
+  }
+
+  if (argc - optind != 2) {
+    fprintf(stderr,
+            "usage: %s [-a segments] [-d delay_us] [-w segments] [-m bytes] "
+            "[-O] [-e mmsg|uring] [-s] [-n connections] [-t threads] [-f] "
+            "[-r bytes_per_second] [-K key_file] UDP_port filename_to_write\n"
+            "  -a  acknowledge every given number of segments (default %d)\n"
+            "  -d  longest time an ACK is delayed in microseconds "
+            "(default %d)\n"
+            "  -w  segments the receive buffer holds (default %d)\n"
+            "  -m  largest segment payload accepted in bytes (default %d)\n"
+            "  -O  receive coalesced segments with UDP GRO\n"
+            "  -e  system calls segments and writes are moved with "
+            "(default mmsg)\n"
+            "  -s  serve transfers from many senders, each one written to "
+            "filename_to_write.address.port\n"
+            "  -n  transfers served at once with -s (default %d)\n"
+            "  -t  worker threads serving transfers with -s, each with its "
+            "own socket (default 1)\n"
+            "  -f  receive sessions of many files, written to the directory "
+            "filename_to_write\n"
+            "  -r  bytes per second written in total, the senders are slowed "
+            "down to share that rate (default no limit)\n"
+            "  -K  file the fast open key is kept in, created if missing, so "
+            "cookies outlive a restart (default a new key every run)\n\n",
+            argv[0], DEFAULT_ACK_EVERY, DEFAULT_ACK_DELAY_US,
+            DEFAULT_RECEIVE_WINDOW, MAX_SEGMENT_DATA_SIZE,
+            DEFAULT_MAX_CONNECTIONS);
+    exit(1);
+  }
+
+  udp_port = (unsigned short int)atoi(argv[optind]);
+  filename_to_write = argv[optind + 1];
+
+  int retval;
+  if (session) {
+    retval = receive_sessions(udp_port, filename_to_write, &options);
+  } else {
+    retval =
+        rrecv_with_options(udp_port, filename_to_write, write_rate, &options);
+  }
+  return retval < 0 ? EXIT_FAILURE : EXIT_SUCCESS;
+}
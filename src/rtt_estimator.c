@@ -0,0 +1,61 @@
+/**
+ * @file rtt_estimator.c
+ * @brief Function definitions for estimating the round trip time and the
+ * retransmission timeout
+ *
+ * This file contains the function definitions for keeping a smoothed round
+ * trip time and its variation, deriving the retransmission timeout from them
+ * as described in RFC 6298, and backing the timeout off exponentially.
+ *
+ * @author Ritam Singal (ritamsingal)
+ * @author Harshil Patel (harshil-patel11)
+ * @bug No known bugs
+ */
+
+#include "../include/rtt_estimator.h"
+#include "../include/tcp_utils.h"
+#include "../include/utils.h"
+
+void init_rtt_estimator(rtt_estimator_t *rtt) {
+  rtt->srtt_us = 0;
+  rtt->rttvar_us = 0;
+  rtt->rto_us = INITIAL_RTO_US;
+  rtt->has_sample = 0;
+}
+
+void update_rtt_estimator(rtt_estimator_t *rtt, long sample_us) {
+  if (!rtt->has_sample) {
+    rtt->srtt_us = sample_us;
+    rtt->rttvar_us = sample_us / 2;
+    rtt->has_sample = 1;
+  } else {
+    // RTTVAR = 3/4 RTTVAR + 1/4 |SRTT - R|, SRTT = 7/8 SRTT + 1/8 R
+    long error = rtt->srtt_us - sample_us;
+    if (error < 0) {
+      error = -error;
+    }
+    rtt->rttvar_us = (3 * rtt->rttvar_us + error) / 4;
+    rtt->srtt_us = (7 * rtt->srtt_us + sample_us) / 8;
+  }
+
+  long rto_us =
+      rtt->srtt_us + MAX(TIMER_GRANULARITY_US, 4 * rtt->rttvar_us);
+  rtt->rto_us = MIN(MAX_RTO_US, MAX(MIN_RTO_US, rto_us));
+}
+
+void backoff_rto(rtt_estimator_t *rtt) {
+  rtt->rto_us = MIN(MAX_RTO_US, 2 * rtt->rto_us);
+}
+
+long rtt_sample_from_echo(uint32_t ts_ecr) {
+  if (ts_ecr == 0) {
+    return -1;
+  }
+
+  // timestamps are the low 32 bits of the clock, so wrap-around is harmless
+  int32_t elapsed = (int32_t)((uint32_t)get_time_us() - ts_ecr);
+  if (elapsed < 0) {
+    return -1;
+  }
+  return elapsed;
+}
@@ -7,13 +7,17 @@
  * and receiving ACKs from the receiver, establishing a connection with the
  * receiver, and closing the connection with the receiver.
  *
- * The main() function runs the sender and sends data to the receiver using a
- * UDP socket.
+ * The main() function of the sender lives in sender_main.c, so this file can
+ * be part of libtcpudp.
  *
- * The sender sends data to the receiver using a Go-back-n protocol. The sender
- * sends packets to the receiver and waits for ACKs from the receiver. If the
- * sender does not receive an ACK for a packet, it resends the packet and all
- * subsequent packets.
+ * The sender keeps a sliding window of segments in flight, sized by the
+ * congestion control and the window the receiver advertises, and paces them
+ * over the round trip. Every segment has its own retransmit deadline. The
+ * cumulative ACK and the SACK blocks of each ACK mark the segments the
+ * receiver holds, so only the missing segments are resent: right away once
+ * duplicate ACKs or later SACKed segments show they were lost, or when their
+ * deadline passes. Go-back-N, which resends every segment after a lost one,
+ * is kept as an option.
  *
  * @author Ritam Singal (ritamsingal)
  * @author Harshil Patel (harshil-patel11)
@@ -27,7 +31,9 @@
 #include <stdlib.h>
 #include <string.h>
 
+#include <sys/mman.h>
 #include <sys/socket.h>
+#include <sys/stat.h>
 #include <sys/types.h>
 #include <unistd.h>
 
@@ -35,38 +41,49 @@
 #include <pthread.h>
 #include <sys/time.h>
 
+#include "../include/fast_open.h"
 #include "../include/sender.h"
+#include "../include/tcp_io.h"
 #include "../include/tcp_segment.h"
 #include "../include/tcp_utils.h"
 #include "../include/utils.h"
 
-// https://www.educative.io/answers/how-to-implement-udp-sockets-in-c
+void init_sender_options(sender_options_t *options) {
+  options->retransmit_mode = SELECTIVE_REPEAT;
+  options->cc_algorithm = CC_AIMD;
+  options->max_window = DEFAULT_MAX_WINDOW;
+  options->segment_size = DEFAULT_SEGMENT_DATA_SIZE;
+  options->probe_path_mtu = 0;
+  options->offload = 0;
+  options->io_engine = IO_ENGINE_MMSG;
+  options->map_file = 0;
+  options->num_streams = 1;
+  options->checksum_type = CHECKSUM_INTERNET;
+  options->cookie_file = NULL;
+  options->max_rate = 0;
+}
+
 void rsend(char *hostname, unsigned short int hostUDPport, char *filename,
            unsigned long long int bytesToTransfer) {
+  sender_options_t options;
+  init_sender_options(&options);
+  rsend_with_options(hostname, hostUDPport, filename, bytesToTransfer,
+                     &options);
+}
 
-  unsigned long long int numBytesToTransfer = bytesToTransfer;
-  FILE *file = fopen(filename, "r");
-  if (file == NULL) {
-    printf("Couldn't open file\n");
-    return -1;
-  }
-
-  int socket_desc = create_socket();
-  if (socket_desc < 0) {
-    printf("Error while creating socket\n");
-    fclose(file);
-    return -1;
-  }
+// https://www.educative.io/answers/how-to-implement-udp-sockets-in-c
+int rsend_with_options(char *hostname, unsigned short int hostUDPport,
+                       char *filename, unsigned long long int bytesToTransfer,
+                       sender_options_t *options) {
 
   char *server_ip;
   struct sockaddr_in server_addr;
+  memset(&server_addr, 0, sizeof(server_addr));
 
   printf("Hostname: %s\n", hostname);
   if (get_host_ip_by_hostname(&server_ip, hostname) < 0) {
     printf("Couldn't get server IP\n");
-    close(socket_desc);
-    fclose(file);
-    return -1;
+    return UNKNOWN_FAILURE;
   }
   printf("Server IP: %s\n", server_ip);
 
@@ -74,6 +91,108 @@ void rsend(char *hostname, unsigned short int hostUDPport, char *filename,
   server_addr.sin_port = htons(hostUDPport);
   server_addr.sin_addr.s_addr = inet_addr(server_ip);
 
+  // only a regular file can be read from several offsets at once, and the
+  // receiver sizes its file by the stripes
+  uint32_t num_streams = MAX(options->num_streams, 1);
+  struct stat file_stat;
+  if (num_streams > 1) {
+    if (stat(filename, &file_stat) < 0 || !S_ISREG(file_stat.st_mode)) {
+      printf("Only regular files can be striped, sending one stream\n");
+      num_streams = 1;
+    } else {
+      bytesToTransfer =
+          MIN(bytesToTransfer, (unsigned long long int)file_stat.st_size);
+    }
+  }
+
+  // the streams get equal ranges that start at aligned offsets, so each one
+  // can be mapped on its own
+  unsigned long long int stripe_size = bytesToTransfer;
+  if (num_streams > 1) {
+    stripe_size = (bytesToTransfer + num_streams - 1) / num_streams;
+    stripe_size = MAX((stripe_size + STRIPE_ALIGNMENT - 1) /
+                          STRIPE_ALIGNMENT * STRIPE_ALIGNMENT,
+                      STRIPE_ALIGNMENT);
+    num_streams = MAX((bytesToTransfer + stripe_size - 1) / stripe_size, 1);
+  }
+
+  sender_stream_t *streams = calloc(num_streams, sizeof(sender_stream_t));
+  if (streams == NULL) {
+    printf("Couldn't allocate streams\n");
+    return UNKNOWN_FAILURE;
+  }
+  uint32_t transfer_id = (uint32_t)(get_time_us() * 2654435761u) ^ getpid();
+  for (uint32_t i = 0; i < num_streams; i++) {
+    sender_stream_t *stream = &streams[i];
+    stream->server_addr = server_addr;
+    stream->filename = filename;
+    stream->options = options;
+    stream->stripe.offset = i * stripe_size;
+    stream->num_bytes =
+        MIN(stripe_size, bytesToTransfer - stream->stripe.offset);
+    if (num_streams > 1) {
+      stream->stripe.transfer_id = MAX(transfer_id, 1);
+      stream->stripe.num_streams = num_streams;
+      stream->stripe.total_bytes = bytesToTransfer;
+    }
+  }
+
+  // the calling thread sends the first stream
+  uint32_t num_started = 1;
+  while (num_started < num_streams) {
+    if (pthread_create(&streams[num_started].thread, NULL, sender_worker,
+                       &streams[num_started]) != 0) {
+      printf("Couldn't start stream thread\n");
+      break;
+    }
+    num_started++;
+  }
+
+  int retval = send_stream(&streams[0]);
+  for (uint32_t i = 1; i < num_started; i++) {
+    pthread_join(streams[i].thread, NULL);
+    // the first stream that failed tells why the transfer failed
+    if (retval == SUCCESS) {
+      retval = streams[i].retval;
+    }
+  }
+  if (retval == SUCCESS && num_started < num_streams) {
+    retval = UNKNOWN_FAILURE;
+  }
+  free(streams);
+  return retval;
+}
+
+void *sender_worker(void *arg) {
+  sender_stream_t *stream = arg;
+  stream->retval = send_stream(stream);
+  return NULL;
+}
+
+int send_stream(sender_stream_t *stream) {
+  sender_options_t *options = stream->options;
+  struct sockaddr_in *server_addr = &stream->server_addr;
+  unsigned short int hostUDPport = ntohs(server_addr->sin_port);
+  unsigned long long int offset = stream->stripe.offset;
+
+  FILE *file = fopen(stream->filename, "r");
+  if (file == NULL) {
+    printf("Couldn't open file\n");
+    return UNKNOWN_FAILURE;
+  }
+  if (offset > 0 && fseeko(file, offset, SEEK_SET) < 0) {
+    printf("Couldn't seek file\n");
+    fclose(file);
+    return UNKNOWN_FAILURE;
+  }
+
+  int socket_desc = create_socket();
+  if (socket_desc < 0) {
+    printf("Error while creating socket\n");
+    fclose(file);
+    return UNKNOWN_FAILURE;
+  }
+
   struct sockaddr_in client_addr;
   socklen_t client_addr_len = sizeof(client_addr);
   if (getsockname(socket_desc, (struct sockaddr *)&client_addr,
@@ -81,222 +200,1058 @@ void rsend(char *hostname, unsigned short int hostUDPport, char *filename,
     printf("Couldn't get socket name\n");
     close(socket_desc);
     fclose(file);
-    return -1;
+    return UNKNOWN_FAILURE;
   }
   in_port_t client_port = ntohs(client_addr.sin_port);
 
+  syn_options_t syn_options = stream->stripe;
+  syn_options.segment_size = options->segment_size;
+  syn_options.checksum_type = options->checksum_type;
+  // a cached cookie also fixes the segment size, as the first window is sent
+  // before the SYN-ACK could negotiate another one
+  fast_open_cookie_t cookie = {0};
+  int fast_open = options->cookie_file != NULL &&
+                  load_fast_open_cookie(options->cookie_file, server_addr,
+                                        &cookie);
+  if (options->cookie_file != NULL) {
+    syn_options.fast_open = 1;
+    syn_options.cookie = cookie.cookie;
+  }
+  if (fast_open) {
+    syn_options.segment_size =
+        MAX(MIN(cookie.segment_size, syn_options.segment_size),
+            MIN_SEGMENT_DATA_SIZE);
+  } else if (options->probe_path_mtu) {
+    int path_segment_size = probe_segment_size(server_addr);
+    if (path_segment_size > 0) {
+      syn_options.segment_size =
+          MAX(MIN(path_segment_size, MAX_SEGMENT_DATA_SIZE),
+              MIN_SEGMENT_DATA_SIZE);
+    }
+  }
+  syn_options_t proposed = syn_options;
+
+  // the socket has to absorb bursts as large as the window; the negotiated
+  // segments are never larger than the proposed ones
+  set_socket_buffers(socket_desc,
+                     options->max_window *
+                         (sizeof(tcp_header_t) + syn_options.segment_size));
+
+  rtt_estimator_t rtt;
+  init_rtt_estimator(&rtt);
+  congestion_control_t cc;
+  init_congestion_control(&cc, options->cc_algorithm, options->max_window);
+
+  // the transfer runs on ACKs and on the retransmit timer
+  send_window_t window = {0};
+  send_buffer_t buffer = {0};
+  tcp_io_t io = {0};
+  sender_state_t state = {.socket_desc = socket_desc,
+                          .host_udp_port = hostUDPport,
+                          .client_port = client_port,
+                          .server_addr = server_addr,
+                          .file = file,
+                          .window = &window,
+                          .buffer = &buffer};
+  if (init_tcp_io(&io, socket_desc, IO_BATCH_SIZE, options->offload,
+                  options->io_engine) < 0 ||
+      start_send_transfer(&state, stream, syn_options.segment_size,
+                          syn_options.checksum_type, &rtt, &cc, &io) < 0) {
+    printf("Couldn't allocate send window\n");
+    free_tcp_io(&io);
+    free_send_buffer(&buffer);
+    free_send_window(&window);
+    close(socket_desc);
+    fclose(file);
+    return UNKNOWN_FAILURE;
+  }
+  // the first window is only limited by congestion control
+  if (fast_open) {
+    window.receive_window_end = cc_window(&cc);
+  }
+
+  event_loop_t loop;
+  if (init_event_loop(&loop) < 0) {
+    printf("Couldn't create event loop\n");
+    free_tcp_io(&io);
+    free_send_buffer(&buffer);
+    free_send_window(&window);
+    fclose(file);
+    close(socket_desc);
+    return UNKNOWN_FAILURE;
+  }
+  if (add_event_source(&loop, &state.socket_source, socket_desc, EPOLLIN,
+                       handle_sender_socket, &state) < 0 ||
+      init_event_timer(&loop, &state.retransmit_timer,
+                       handle_retransmit_timer, &state) < 0) {
+    printf("Couldn't create event loop\n");
+    free_event_loop(&loop);
+    free_tcp_io(&io);
+    free_send_buffer(&buffer);
+    free_send_window(&window);
+    fclose(file);
+    close(socket_desc);
+    return UNKNOWN_FAILURE;
+  }
+
+  uint32_t receive_window;
+  uint32_t receiver_isn;
   if (establish_connection_sender(client_port, hostUDPport, socket_desc,
-                                  &server_addr, &client_addr) != SUCCESS) {
+                                  server_addr, &client_addr, &rtt,
+                                  &receive_window, &receiver_isn, &syn_options,
+                                  fast_open ? &state : NULL) != SUCCESS) {
     printf("Couldn't establish connection\n");
+    free_event_timer(&loop, &state.retransmit_timer);
+    free_event_loop(&loop);
+    free_tcp_io(&io);
+    free_send_buffer(&buffer);
+    free_send_window(&window);
     close(socket_desc);
     fclose(file);
-    return -1;
+    return UNKNOWN_FAILURE;
   }
+  uint16_t segment_size = syn_options.segment_size;
+  printf("Segment size: %d bytes\n", segment_size);
 
-  uint32_t seq_number = 0;
-  char buffer[SEGMENT_DATA_SIZE * 1024];
-  char *buffer_ptr = buffer;
-  size_t bytes_in_buffer = 0;
-  int window_size = 1;
+  // the receiver drops the first window unless it took the cookie, which it
+  // only does with the segment size and checksum the window was sent with
+  int accepted = fast_open && syn_options.fast_open &&
+                 syn_options.cookie == proposed.cookie &&
+                 segment_size == proposed.segment_size &&
+                 syn_options.checksum_type == proposed.checksum_type;
+  if (fast_open) {
+    printf(accepted ? "Fast open accepted\n"
+                    : "Fast open rejected, sending the first window again\n");
+  }
+  if ((fast_open && !accepted) || segment_size != proposed.segment_size) {
+    if (start_send_transfer(&state, stream, segment_size,
+                            syn_options.checksum_type, &rtt, &cc, &io) < 0) {
+      printf("Couldn't allocate send window\n");
+      free_event_timer(&loop, &state.retransmit_timer);
+      free_event_loop(&loop);
+      free_tcp_io(&io);
+      free_send_buffer(&buffer);
+      free_send_window(&window);
+      close(socket_desc);
+      fclose(file);
+      return UNKNOWN_FAILURE;
+    }
+  }
+  window.checksum_type = syn_options.checksum_type;
+  window.receive_window_end = receive_window;
+  window.receiver_isn = receiver_isn;
 
-  while (1) {
-    if (bytes_in_buffer == 0) {
-      if (numBytesToTransfer == 0) {
-        break;
-      }
+  // a failure to cache the cookie only costs the next transfer a round trip
+  if (syn_options.fast_open &&
+      (syn_options.cookie != cookie.cookie ||
+       segment_size != cookie.segment_size)) {
+    cookie.cookie = syn_options.cookie;
+    cookie.segment_size = segment_size;
+    if (store_fast_open_cookie(options->cookie_file, server_addr, &cookie) <
+        0) {
+      printf("Couldn't store fast open cookie\n");
+    }
+  }
 
-      memset(buffer, '\0', sizeof(buffer));
-      bytes_in_buffer = fread(buffer, 1, sizeof(buffer), file);
-      if (bytes_in_buffer == 0) {
-        break;
-      }
-      if (bytes_in_buffer > numBytesToTransfer) {
-        bytes_in_buffer = numBytesToTransfer;
-        // set extra bytes read to NULL
-        memset(buffer + bytes_in_buffer, '\0',
-               sizeof(buffer) - bytes_in_buffer);
-      }
-      numBytesToTransfer -= bytes_in_buffer;
-      buffer_ptr = buffer;
-    }
-
-    int num_packets_sent = 0;
-    int send_and_recv_retval = send_and_recv_packets(
-        socket_desc, hostUDPport, client_port, &server_addr, seq_number,
-        buffer_ptr, bytes_in_buffer, window_size, &num_packets_sent);
-
-    if (send_and_recv_retval != SUCCESS) {
-      if (num_packets_sent == SEND_FAILED || num_packets_sent == RECV_FAILED ||
-          num_packets_sent == UNKNOWN_FAILURE) {
-        printf("Error while sending/receiving packets\n");
-        fclose(file);
-        close(socket_desc);
-        return -1;
-      }
-    } else {
-      if (num_packets_sent * SEGMENT_DATA_SIZE > bytes_in_buffer) {
-        bytes_in_buffer = 0;
-      } else {
-        bytes_in_buffer -= num_packets_sent * SEGMENT_DATA_SIZE;
-      }
+  int loop_retval = advance_sender(&state);
+  if (loop_retval == EVENT_CONTINUE) {
+    loop_retval = run_event_loop(&loop);
+  }
+  free_event_timer(&loop, &state.retransmit_timer);
+  free_event_loop(&loop);
+  if (loop_retval != EVENT_STOP) {
+    printf("Error while sending/receiving packets\n");
+    free_tcp_io(&io);
+    free_send_buffer(&buffer);
+    free_send_window(&window);
+    fclose(file);
+    close(socket_desc);
+    return loop_retval < 0 ? loop_retval : UNKNOWN_FAILURE;
+  }
 
-      seq_number += num_packets_sent;
-      buffer_ptr += num_packets_sent * SEGMENT_DATA_SIZE;
-      if (num_packets_sent != window_size) {
-        window_size = MAX(1, window_size / 2);
-      } else if (window_size < MAX_WINDOW_SIZE) {
-        window_size = MIN(MAX_WINDOW_SIZE, window_size + 2);
-      }
+  int close_retval =
+      close_connection_sender(client_port, hostUDPport, socket_desc,
+                              server_addr, &client_addr, &rtt, window.next,
+                              xxh64_digest(&window.digest));
+  if (close_retval != SUCCESS) {
+    if (close_retval == DIGEST_MISMATCH) {
+      printf("Receiver rejected the file digest\n");
+    } else if (close_retval == WRITE_FAILED) {
+      printf("Receiver couldn't write the file\n");
+    } else if (close_retval == CONNECTION_RESET) {
+      printf("Receiver reset the connection\n");
+    } else {
+      printf("Receiver did not confirm the file\n");
     }
+    free_tcp_io(&io);
+    free_send_buffer(&buffer);
+    free_send_window(&window);
+    fclose(file);
+    close(socket_desc);
+    return close_retval;
   }
 
-  close_connection_sender(client_port, hostUDPport, socket_desc, &server_addr,
-                          &client_addr);
-
+  free_tcp_io(&io);
+  free_send_buffer(&buffer);
+  free_send_window(&window);
   fclose(file);
   close(socket_desc);
 
+  return SUCCESS;
+}
+
+int start_send_transfer(sender_state_t *state, sender_stream_t *stream,
+                        uint16_t segment_size, checksum_type_t checksum_type,
+                        rtt_estimator_t *rtt, congestion_control_t *cc,
+                        tcp_io_t *io) {
+  sender_options_t *options = stream->options;
+  send_window_t *window = state->window;
+  send_buffer_t *buffer = state->buffer;
+  unsigned long long int offset = stream->stripe.offset;
+
+  free_send_buffer(buffer);
+  free_send_window(window);
+  memset(buffer, 0, sizeof(*buffer));
+  state->bytes_left = stream->num_bytes;
+  if (fseeko(state->file, offset, SEEK_SET) < 0) {
+    return -1;
+  }
+
+  // the send buffer holds two windows, so it can be refilled while a full
+  // window is in flight; files that cannot be mapped are read into it
+  int buffer_retval = -1;
+  if (options->map_file) {
+    buffer_retval = map_send_buffer(buffer, state->file, offset,
+                                    stream->num_bytes, segment_size);
+  }
+  if (buffer_retval < 0) {
+    buffer_retval =
+        init_send_buffer(buffer, 2 * options->max_window, segment_size);
+  }
+  if (buffer_retval < 0 || init_send_window(window, options->max_window) < 0) {
+    return -1;
+  }
+  window->io = io;
+  window->retransmit_mode = options->retransmit_mode;
+  window->checksum_type = checksum_type;
+  window->rtt = rtt;
+  window->cc = cc;
+  // the streams of a striped transfer share the cap of the operator
+  window->max_rate = (double)options->max_rate /
+                     MAX(stream->stripe.num_streams, 1) /
+                     (sizeof(tcp_header_t) + segment_size);
   return 0;
 }
 
-tcp_error_t
-send_and_recv_packets(int socket_desc, unsigned short int host_udp_port,
-                      in_port_t client_port, struct sockaddr_in *server_addr,
-                      uint32_t seq_number, char *buffer, size_t bytes_in_buffer,
-                      int window_size, int *retval) {
+int init_send_window(send_window_t *window, uint32_t max_window) {
+  memset(window, 0, sizeof(*window));
+  window->slots = calloc(max_window, sizeof(send_slot_t));
+  window->queue = malloc(4 * (size_t)max_window * sizeof(retransmit_entry_t));
+  if (window->slots == NULL || window->queue == NULL) {
+    return -1;
+  }
+  window->max_window = max_window;
+  window->queue_size = 4 * max_window;
+  init_file_digest(&window->digest);
+  return 0;
+}
 
-  int num_packets =
-      MIN(window_size, CEIL(bytes_in_buffer / (float)SEGMENT_DATA_SIZE));
-  int seq_number_acks[num_packets];
-  memset(seq_number_acks, 0, sizeof(seq_number_acks));
+void free_send_window(send_window_t *window) {
+  free(window->slots);
+  free(window->queue);
+  window->slots = NULL;
+  window->queue = NULL;
+}
 
-  // send packets
-  for (int i = 0; i < num_packets; i++) {
-    tcp_segment_t send_segment;
-    create_tcp_segment(client_port, host_udp_port, seq_number + i, 0, 0, buffer,
-                       SEGMENT_DATA_SIZE, &send_segment);
-    int send_retval = send_tcp(socket_desc, &send_segment, server_addr);
-    if (send_retval == SEND_FAILED) {
-      printf("Couldn't send packet with seq number %d\n", seq_number + i);
-      return SEND_FAILED;
+int init_send_buffer(send_buffer_t *buffer, uint32_t num_segments,
+                     uint16_t segment_size) {
+  buffer->data = malloc((size_t)num_segments * segment_size);
+  buffer->segment_lens = NULL;
+  if (buffer->data == NULL) {
+    return -1;
+  }
+  buffer->num_segments = num_segments;
+  buffer->segment_size = segment_size;
+  buffer->base_seq = 0;
+  buffer->num_bytes = 0;
+  buffer->eof = 0;
+  buffer->mapped = 0;
+  return 0;
+}
+
+int init_stream_buffer(send_buffer_t *buffer, uint32_t num_segments,
+                       uint16_t segment_size) {
+  if (init_send_buffer(buffer, num_segments, segment_size) < 0) {
+    return -1;
+  }
+  buffer->segment_lens = malloc(num_segments * sizeof(uint16_t));
+  if (buffer->segment_lens == NULL) {
+    free_send_buffer(buffer);
+    return -1;
+  }
+  return 0;
+}
+
+int map_send_buffer(send_buffer_t *buffer, FILE *file,
+                    unsigned long long int offset,
+                    unsigned long long int num_bytes, uint16_t segment_size) {
+  struct stat file_stat;
+  int file_desc = fileno(file);
+  if (fstat(file_desc, &file_stat) < 0 || !S_ISREG(file_stat.st_mode)) {
+    return -1;
+  }
+
+  unsigned long long int file_size = file_stat.st_size;
+  size_t map_len = MIN(file_size - MIN(offset, file_size), num_bytes);
+  buffer->data = NULL;
+  buffer->segment_lens = NULL;
+  if (map_len > 0) {
+    void *map =
+        mmap(NULL, map_len, PROT_READ, MAP_PRIVATE, file_desc, (off_t)offset);
+    if (map == MAP_FAILED) {
+      return -1;
     }
-    buffer += SEGMENT_DATA_SIZE;
+    madvise(map, map_len, MADV_SEQUENTIAL);
+    buffer->data = map;
   }
 
-  // receive acks
-  for (int i = 0; i < num_packets; i++) {
-    tcp_segment_t recv_segment;
-    int recv_result =
-        recv_tcp_with_timeout(socket_desc, server_addr, &recv_segment);
-    if (recv_result == TIMEOUT) {
+  buffer->num_segments = (map_len + segment_size - 1) / segment_size;
+  buffer->segment_size = segment_size;
+  buffer->base_seq = 0;
+  buffer->num_bytes = map_len;
+  buffer->eof = 1;
+  buffer->mapped = 1;
+  return 0;
+}
+
+void free_send_buffer(send_buffer_t *buffer) {
+  if (buffer->mapped) {
+    if (buffer->data != NULL) {
+      munmap(buffer->data, buffer->num_bytes);
+    }
+  } else {
+    free(buffer->data);
+  }
+  free(buffer->segment_lens);
+  buffer->data = NULL;
+  buffer->segment_lens = NULL;
+}
+
+void refill_send_buffer(send_buffer_t *buffer, FILE *file,
+                        uint32_t window_base, uint32_t window_next,
+                        unsigned long long int *bytes_left) {
+
+  if (buffer->eof) {
+    return;
+  }
+  // only refill once half of the buffer has been acknowledged, so the file is
+  // read in large chunks, or once the window has caught up with the end of
+  // the buffer
+  uint32_t consumed = window_base - buffer->base_seq;
+  if (consumed < buffer->num_segments / 2 &&
+      window_next < send_buffer_end(buffer)) {
+    return;
+  }
+
+  // segments before the end of file are always full, so the slots of the
+  // acknowledged ones are reused and the file is read into the slots after
+  // the last one, in two parts where they wrap around
+  size_t consumed_bytes =
+      MIN(consumed * (size_t)buffer->segment_size, buffer->num_bytes);
+  buffer->num_bytes -= consumed_bytes;
+  buffer->base_seq = window_base;
+
+  size_t capacity = buffer->num_segments * (size_t)buffer->segment_size;
+  size_t bytes_to_read = MIN(capacity - buffer->num_bytes, *bytes_left);
+  size_t bytes_read = 0;
+  while (bytes_read < bytes_to_read) {
+    uint32_t index = buffer->num_bytes / buffer->segment_size;
+    uint32_t slot = (buffer->base_seq + index) % buffer->num_segments;
+    size_t offset = slot * (size_t)buffer->segment_size;
+    size_t chunk = MIN(capacity - offset, bytes_to_read - bytes_read);
+    size_t chunk_read = fread(buffer->data + offset, 1, chunk, file);
+    buffer->num_bytes += chunk_read;
+    bytes_read += chunk_read;
+    if (chunk_read < chunk) {
       break;
-    } else if (recv_result == RECV_FAILED || recv_result == UNKNOWN_FAILURE) {
-      return recv_result;
-    } else if (recv_result == SUCCESS) {
-      uint32_t local_seq_number = recv_segment.ack_number - seq_number;
-      if (local_seq_number >= 0 && local_seq_number < num_packets) {
-        seq_number_acks[local_seq_number] = 1;
-      } else {
-        i--;
+    }
+  }
+  *bytes_left -= bytes_read;
+  if (bytes_read < bytes_to_read || *bytes_left == 0) {
+    buffer->eof = 1;
+  }
+}
+
+size_t append_send_buffer(send_buffer_t *buffer, uint32_t window_base,
+                          const char *data, size_t len) {
+  // acknowledged segments are sealed, so each takes segment_size bytes and
+  // their slots can be reused
+  uint32_t consumed = window_base - buffer->base_seq;
+  buffer->num_bytes -= consumed * (size_t)buffer->segment_size;
+  buffer->base_seq = window_base;
+
+  size_t capacity = buffer->num_segments * (size_t)buffer->segment_size;
+  size_t num_appended = MIN(len, capacity - buffer->num_bytes);
+  size_t end = buffer->num_bytes + num_appended;
+  while (buffer->num_bytes < end) {
+    uint32_t index = buffer->num_bytes / buffer->segment_size;
+    uint32_t slot = (buffer->base_seq + index) % buffer->num_segments;
+    size_t slot_offset = buffer->num_bytes % buffer->segment_size;
+    size_t chunk = MIN(buffer->segment_size - slot_offset,
+                       end - buffer->num_bytes);
+    memcpy(buffer->data + slot * (size_t)buffer->segment_size + slot_offset,
+           data, chunk);
+    buffer->segment_lens[slot] = slot_offset + chunk;
+    buffer->num_bytes += chunk;
+    data += chunk;
+  }
+  return num_appended;
+}
+
+void seal_send_buffer(send_buffer_t *buffer) {
+  // the rest of the last segment is left unused, its length stays as it is
+  size_t partial = buffer->num_bytes % buffer->segment_size;
+  if (partial > 0) {
+    buffer->num_bytes += buffer->segment_size - partial;
+  }
+}
+
+uint32_t send_buffer_end(send_buffer_t *buffer) {
+  if (!buffer->eof) {
+    return buffer->base_seq + buffer->num_bytes / buffer->segment_size;
+  }
+  return buffer->base_seq +
+         (buffer->num_bytes + buffer->segment_size - 1) / buffer->segment_size;
+}
+
+uint16_t send_segment_len(send_buffer_t *buffer, uint32_t seq_number) {
+  if (buffer->segment_lens != NULL) {
+    return buffer->segment_lens[seq_number % buffer->num_segments];
+  }
+  size_t offset =
+      (seq_number - buffer->base_seq) * (size_t)buffer->segment_size;
+  return MIN(buffer->num_bytes - offset, buffer->segment_size);
+}
+
+char *send_segment_data(send_buffer_t *buffer, uint32_t seq_number) {
+  // a mapped file starts at sequence number 0 and never wraps around
+  return buffer->data +
+         (seq_number % buffer->num_segments) * (size_t)buffer->segment_size;
+}
+
+tcp_error_t send_data_segment(unsigned short int host_udp_port,
+                              in_port_t client_port,
+                              struct sockaddr_in *server_addr,
+                              send_window_t *window, send_buffer_t *buffer,
+                              uint32_t seq_number) {
+
+  // the send buffer is only refilled after the batch is flushed, so the
+  // payload is sent straight from it
+  tcp_segment_t send_segment;
+  create_tcp_segment(client_port, host_udp_port, seq_number,
+                     window->receiver_isn, 0, NULL, 0, &send_segment);
+  send_segment.checksum_type = window->checksum_type;
+  send_segment.data_len = send_segment_len(buffer, seq_number);
+  if (queue_tcp_payload(window->io, &send_segment,
+                        send_segment_data(buffer, seq_number),
+                        server_addr) != SUCCESS) {
+    printf("Couldn't send packet with seq number %d\n", seq_number);
+    return SEND_FAILED;
+  }
+
+  // go back n also resends segments the receiver already acknowledged
+  send_slot_t *slot = &window->slots[seq_number % window->max_window];
+  if (slot->acked && seq_number - window->base < window->next - window->base) {
+    window->num_sacked--;
+  }
+  uint64_t now = get_time_us();
+  slot->deadline_us = now + window->rtt->rto_us;
+  slot->acked = 0;
+  pace_transmission(window, now);
+  push_retransmit_entry(window, seq_number, slot->deadline_us);
+  window->num_sent++;
+  return SUCCESS;
+}
+
+int is_retransmit_entry_live(send_window_t *window, retransmit_entry_t *entry) {
+  uint32_t seq_number = entry->seq_number;
+  if (seq_number - window->base >= window->next - window->base) {
+    return 0;
+  }
+  send_slot_t *slot = &window->slots[seq_number % window->max_window];
+  return !slot->acked && slot->deadline_us == entry->deadline_us;
+}
+
+void push_retransmit_entry(send_window_t *window, uint32_t seq_number,
+                           uint64_t deadline_us) {
+  if (window->queue_tail - window->queue_head == window->queue_size) {
+    // drop the entries of acknowledged or retransmitted segments; at most one
+    // entry per in-flight segment is live, so this always frees space
+    uint32_t live_tail = window->queue_head;
+    for (uint32_t i = window->queue_head; i != window->queue_tail; i++) {
+      retransmit_entry_t *entry = &window->queue[i % window->queue_size];
+      if (is_retransmit_entry_live(window, entry)) {
+        window->queue[live_tail++ % window->queue_size] = *entry;
       }
     }
+    window->queue_tail = live_tail;
   }
 
-  // find lowest seq number packet that was acked
-  int lowest_seq_number_packet = -1;
+  retransmit_entry_t *entry =
+      &window->queue[window->queue_tail++ % window->queue_size];
+  entry->seq_number = seq_number;
+  entry->deadline_us = deadline_us;
+}
 
-  for (int i = 0; i < num_packets; i++) {
-    if (seq_number_acks[i] == 0) {
+retransmit_entry_t *next_retransmit_entry(send_window_t *window) {
+  while (window->queue_head != window->queue_tail) {
+    retransmit_entry_t *entry =
+        &window->queue[window->queue_head % window->queue_size];
+    if (is_retransmit_entry_live(window, entry)) {
+      return entry;
+    }
+    window->queue_head++;
+  }
+  return NULL;
+}
+
+tcp_error_t send_new_segments(unsigned short int host_udp_port,
+                              in_port_t client_port,
+                              struct sockaddr_in *server_addr,
+                              send_window_t *window, send_buffer_t *buffer) {
+
+  uint64_t now = get_time_us();
+  uint32_t buffer_end = send_buffer_end(buffer);
+  while (window->next < buffer_end &&
+         window->next - window->base < window->max_window &&
+         window->next - window->base - window->num_sacked <
+             cc_window(window->cc) &&
+         (int32_t)(window->receive_window_end - window->next) > 0) {
+    if (window->release_us > now) {
+      window->paced = 1;
       break;
-    } else {
-      lowest_seq_number_packet = i;
+    }
+    int send_retval = send_data_segment(host_udp_port, client_port,
+                                        server_addr, window, buffer,
+                                        window->next);
+    if (send_retval != SUCCESS) {
+      return send_retval;
+    }
+    add_segment_hash(&window->digest,
+                     xxh64(send_segment_data(buffer, window->next),
+                           send_segment_len(buffer, window->next), 0));
+    window->next++;
+  }
+
+  return flush_tcp(window->io);
+}
+
+double sender_pacing_rate(send_window_t *window) {
+  congestion_control_t *cc = window->cc;
+  rtt_estimator_t *rtt = window->rtt;
+  double rate = cc_pacing_rate(cc);
+  if (rate <= 0 && rtt->has_sample && rtt->srtt_us > 0) {
+    double gain = cc->cwnd < cc->ssthresh ? PACING_SS_GAIN : PACING_CA_GAIN;
+    rate = gain * cc_window(cc) * 1e6 / rtt->srtt_us;
+  }
+  if (window->max_rate > 0 && (rate <= 0 || rate > window->max_rate)) {
+    rate = window->max_rate;
+  }
+  return rate;
+}
+
+void pace_transmission(send_window_t *window, uint64_t now_us) {
+  double rate = sender_pacing_rate(window);
+  if (rate <= 0) {
+    return;
+  }
+  if (window->release_us + PACING_BURST_US < now_us) {
+    window->release_us = now_us - PACING_BURST_US;
+  }
+  window->release_us += (uint64_t)(1e6 / rate + 0.5);
+}
+
+int mark_segments_acked(send_window_t *window, uint32_t start, uint32_t end) {
+  // parts of the range outside the window are stale duplicates
+  if ((int32_t)(start - window->base) < 0) {
+    start = window->base;
+  }
+  if ((int32_t)(end - window->next) > 0) {
+    end = window->next;
+  }
+
+  int num_acked = 0;
+  for (uint32_t seq = start; (int32_t)(end - seq) > 0; seq++) {
+    send_slot_t *slot = &window->slots[seq % window->max_window];
+    if (!slot->acked) {
+      slot->acked = 1;
+      num_acked++;
+      // the lost segments below retransmit_next were all resent
+      if (window->timeout_recovery && window->timeout_pipe > 0 &&
+          (int32_t)(seq - window->retransmit_next) < 0) {
+        window->timeout_pipe--;
+      }
+    }
+  }
+  return num_acked;
+}
+
+tcp_error_t recv_ack(send_window_t *window) {
+  int recv_retval = recv_tcp_batch(window->io, 0);
+  if (recv_retval == RECV_FAILED || recv_retval == UNKNOWN_FAILURE) {
+    return recv_retval;
+  }
+  tcp_segment_t ack_segment;
+  struct sockaddr_in ack_addr;
+  while (next_tcp_segment(window->io, &ack_segment, &ack_addr)) {
+    if (ack_segment.flags == ACK) {
+      process_ack(window, &ack_segment);
+    } else if (ack_segment.flags == RST) {
+      // the receiver gave up on the connection
+      return CONNECTION_RESET;
     }
   }
 
-  *retval = lowest_seq_number_packet + 1;
   return SUCCESS;
 }
 
+int advance_sender(sender_state_t *state) {
+  send_window_t *window = state->window;
+  send_buffer_t *buffer = state->buffer;
+  if (state->file != NULL) {
+    refill_send_buffer(buffer, state->file, window->base, window->next,
+                       &state->bytes_left);
+  }
+  if (buffer->eof && window->base == send_buffer_end(buffer)) {
+    return EVENT_STOP;
+  }
+
+  // holes are repaired before new segments take the room in the window, and
+  // both wait for the pacer
+  window->paced = 0;
+  mark_expired_segments_lost(window);
+  int send_retval =
+      retransmit_lost_segments(state->host_udp_port, state->client_port,
+                               state->server_addr, window, buffer);
+  if (send_retval == SUCCESS) {
+    send_retval = send_new_segments(state->host_udp_port, state->client_port,
+                                    state->server_addr, window, buffer);
+  }
+  if (send_retval != SUCCESS) {
+    return send_retval;
+  }
+
+  // with nothing in flight only an ACK opening the window moves things on, so
+  // a closed window is probed in case that ACK was lost
+  if (window->next == window->base && window->next < send_buffer_end(buffer) &&
+      (int32_t)(window->receive_window_end - window->next) <= 0) {
+    uint64_t now = get_time_us();
+    if (window->persist_us != 0 && window->persist_us <= now) {
+      send_retval =
+          send_window_probe(state->socket_desc, state->host_udp_port,
+                            state->client_port, state->server_addr, window);
+      if (send_retval != SUCCESS) {
+        return send_retval;
+      }
+      window->num_probes++;
+    }
+    if (window->persist_us == 0 || window->persist_us <= now) {
+      uint64_t interval_us = (uint64_t)window->rtt->rto_us
+                             << MIN(window->num_probes, 16);
+      window->persist_us = now + MIN(interval_us, MAX_RTO_US);
+    }
+  } else {
+    window->persist_us = 0;
+    window->num_probes = 0;
+  }
+
+  retransmit_entry_t *entry = next_retransmit_entry(window);
+  uint64_t deadline_us = entry != NULL ? entry->deadline_us : 0;
+  if (window->paced && (deadline_us == 0 || window->release_us < deadline_us)) {
+    deadline_us = window->release_us;
+  }
+  if (window->persist_us != 0 &&
+      (deadline_us == 0 || window->persist_us < deadline_us)) {
+    deadline_us = window->persist_us;
+  }
+  if (deadline_us != state->timer_deadline_us) {
+    if (arm_event_timer(&state->retransmit_timer, deadline_us) < 0) {
+      return UNKNOWN_FAILURE;
+    }
+    state->timer_deadline_us = deadline_us;
+  }
+  return EVENT_CONTINUE;
+}
+
+int handle_sender_socket(void *context, uint32_t events) {
+  sender_state_t *state = context;
+  (void)events;
+  int recv_retval = recv_ack(state->window);
+  if (recv_retval != SUCCESS) {
+    return recv_retval;
+  }
+  return advance_sender(state);
+}
+
+int handle_retransmit_timer(void *context, uint32_t events) {
+  sender_state_t *state = context;
+  (void)events;
+  state->timer_deadline_us = 0;
+  return advance_sender(state);
+}
+
+void process_ack(send_window_t *window, tcp_segment_t *ack_segment) {
+  uint32_t in_flight = window->next - window->base;
+  uint32_t base = window->base;
+  uint32_t receive_window_end = window->receive_window_end;
+
+  // ACKs that do not move forward may be reordered and carry an old window,
+  // and an ACK beyond the segments sent carries none at all
+  if ((int32_t)(ack_segment->ack_number - window->base) >= 0 &&
+      (int32_t)(ack_segment->ack_number - window->next) <= 0) {
+    window->receive_window_end = ack_segment->ack_number + ack_segment->window;
+  }
+
+  // the receiver holds every segment below the cumulative ACK number and the
+  // segments in the SACK blocks
+  int num_acked =
+      mark_segments_acked(window, window->base, ack_segment->ack_number);
+  if ((int32_t)(ack_segment->ack_number - window->sacked_end) > 0 &&
+      (int32_t)(ack_segment->ack_number - window->next) <= 0) {
+    window->sacked_end = ack_segment->ack_number;
+  }
+  for (int i = 0; i < ack_segment->num_sack_blocks; i++) {
+    sack_block_t *block = &ack_segment->sack_blocks[i];
+    num_acked += mark_segments_acked(window, block->start, block->end);
+    if ((int32_t)(block->end - window->sacked_end) > 0 &&
+        (int32_t)(block->end - window->next) <= 0) {
+      window->sacked_end = block->end;
+    }
+  }
+  window->num_sacked += num_acked;
+
+  // the echoed timestamp belongs to the transmission the receiver answered,
+  // so the sample is valid even if that segment was retransmitted
+  long sample_us = rtt_sample_from_echo(ack_segment->ts_ecr);
+  if (num_acked > 0 && sample_us >= 0) {
+    update_rtt_estimator(window->rtt, sample_us);
+  }
+  if (num_acked > 0) {
+    cc_on_ack(window->cc, num_acked, sample_us, in_flight, get_time_us());
+  }
+
+  while (window->base < window->next &&
+         window->slots[window->base % window->max_window].acked) {
+    window->base++;
+    window->num_sacked--;
+  }
+  if (window->timeout_recovery &&
+      (int32_t)(window->base - window->recovery_seq) >= 0) {
+    window->timeout_recovery = 0;
+  }
+
+  // an ACK that changes nothing while segments are in flight is a duplicate,
+  // a window update is not
+  if (window->base != base) {
+    window->dup_acks = 0;
+  } else if (in_flight > 0 && ack_segment->ack_number == base &&
+             window->receive_window_end == receive_window_end) {
+    window->dup_acks++;
+  }
+
+  // a hole is lost once enough segments sent after it arrived
+  uint32_t lost_end = window->base;
+  if ((int32_t)(window->sacked_end - window->base) > DUPACK_THRESHOLD) {
+    lost_end = window->sacked_end - DUPACK_THRESHOLD;
+  }
+  if (window->dup_acks >= DUPACK_THRESHOLD && lost_end == window->base &&
+      window->base != window->next) {
+    lost_end = window->base + 1;
+  }
+  if ((int32_t)(lost_end - window->lost_end) > 0) {
+    window->lost_end = lost_end;
+  }
+}
+
+tcp_error_t retransmit_lost_segments(unsigned short int host_udp_port,
+                                     in_port_t client_port,
+                                     struct sockaddr_in *server_addr,
+                                     send_window_t *window,
+                                     send_buffer_t *buffer) {
+
+  uint64_t now = get_time_us();
+  uint32_t seq = window->retransmit_next;
+  if ((int32_t)(seq - window->base) < 0) {
+    seq = window->base;
+  }
+  for (; (int32_t)(window->lost_end - seq) > 0; seq++) {
+    if (window->slots[seq % window->max_window].acked) {
+      continue;
+    }
+    // after a timeout the ACKs of the resent segments clock out the rest
+    if (window->timeout_recovery &&
+        window->timeout_pipe >= (uint32_t)cc_window(window->cc)) {
+      break;
+    }
+    if (window->release_us > now) {
+      window->paced = 1;
+      break;
+    }
+
+    // one loss event per window of lost segments
+    if ((int32_t)(seq - window->recovery_seq) >= 0) {
+      cc_on_loss(window->cc, get_time_us());
+      window->recovery_seq = window->next;
+    }
+
+    // after a timeout every segment in flight is lost, so go back n resends
+    // them one at a time as well
+    if (window->retransmit_mode == SELECTIVE_REPEAT ||
+        window->timeout_recovery) {
+      int send_retval = send_data_segment(host_udp_port, client_port,
+                                          server_addr, window, buffer, seq);
+      if (send_retval != SUCCESS) {
+        return send_retval;
+      }
+      window->timeout_pipe += window->timeout_recovery;
+      continue;
+    }
+
+    // go back n: resend this segment and every segment sent after it; the
+    // ones the pacer holds back are resent from retransmit_next later
+    uint32_t resend = seq;
+    for (; resend < window->next; resend++) {
+      if (window->release_us > now) {
+        window->paced = 1;
+        break;
+      }
+      int send_retval = send_data_segment(host_udp_port, client_port,
+                                          server_addr, window, buffer, resend);
+      if (send_retval != SUCCESS) {
+        return send_retval;
+      }
+    }
+    seq = resend;
+    window->lost_end = window->next;
+    break;
+  }
+  window->retransmit_next = seq;
+
+  return flush_tcp(window->io);
+}
+
+void mark_expired_segments_lost(send_window_t *window) {
+  uint64_t now = get_time_us();
+  retransmit_entry_t *entry;
+  while ((entry = next_retransmit_entry(window)) != NULL &&
+         entry->deadline_us <= now) {
+    window->queue_head++;
+
+    // segments sent before the last timeout expire one after another, as the
+    // pacer spread them, but they are all part of that timeout; they are
+    // resent in order, so the ones below retransmit_next were sent since
+    if (window->timeout_recovery &&
+        (int32_t)(entry->seq_number - window->retransmit_next) >= 0) {
+      continue;
+    }
+
+    // retransmissions wait twice as long, until a new RTT sample arrives;
+    // a timeout always collapses the window, even during a recovery, and
+    // every segment in flight is resent as the window lets it
+    backoff_rto(window->rtt);
+    cc_on_timeout(window->cc, now);
+    window->timeout_recovery = 1;
+    window->timeout_pipe = 0;
+    window->recovery_seq = window->next;
+    window->lost_end = window->next;
+    window->retransmit_next = window->base;
+    window->dup_acks = 0;
+  }
+}
+
 tcp_error_t establish_connection_sender(int client_port, int server_port,
                                         int socket_desc,
                                         struct sockaddr_in *server_addr,
-                                        struct sockaddr_in *client_addr) {
+                                        struct sockaddr_in *client_addr,
+                                        rtt_estimator_t *rtt,
+                                        uint32_t *receive_window,
+                                        uint32_t *receiver_isn,
+                                        syn_options_t *syn_options,
+                                        sender_state_t *first_window) {
 
-  char *client_message = "establishing connection";
+  unsigned char client_message[sizeof(syn_options_t)];
+  size_t message_len = write_syn_options(syn_options, client_message);
   tcp_segment_t send_segment;
   create_tcp_segment(client_port, server_port, 0, 0, SYN, client_message,
-                     strlen(client_message), &send_segment);
+                     message_len, &send_segment);
 
   while (1) {
     int send_retval = send_tcp(socket_desc, &send_segment, server_addr);
     if (send_retval != SUCCESS) {
       return send_retval;
     }
+    // segments of the first window that get lost are retransmitted by the
+    // event loop once the connection is established
+    if (first_window != NULL) {
+      int advance_retval = advance_sender(first_window);
+      if (advance_retval != EVENT_CONTINUE && advance_retval != EVENT_STOP) {
+        return advance_retval;
+      }
+      first_window = NULL;
+    }
 
     tcp_segment_t recv_segment;
-    int recv_retval =
-        recv_tcp_with_timeout(socket_desc, client_addr, &recv_segment);
-    if (recv_retval == RECV_FAILED || recv_retval == UNKNOWN_FAILURE) {
-      return recv_retval;
-    } else if (recv_retval == SUCCESS && recv_segment.flags == (SYN | ACK)) {
+    int recv_retval = wait_for_flags(socket_desc, client_addr, SYN | ACK, rtt,
+                                     &recv_segment);
+    if (recv_retval == SUCCESS) {
+      // a SYN-ACK answering a retransmitted SYN may already acknowledge
+      // segments of the first window
+      *receive_window = recv_segment.ack_number + recv_segment.window;
+      *receiver_isn = recv_segment.seq_number;
+      // a receiver that sends no options only gets the smallest segments
+      syn_options_t peer_options = {.segment_size = MIN_SEGMENT_DATA_SIZE};
+      read_syn_options(&recv_segment, &peer_options);
+      syn_options->segment_size =
+          MAX(MIN(syn_options->segment_size, peer_options.segment_size),
+              MIN_SEGMENT_DATA_SIZE);
+      if (peer_options.checksum_type != syn_options->checksum_type) {
+        syn_options->checksum_type = CHECKSUM_INTERNET;
+      }
+      syn_options->fast_open = peer_options.fast_open;
+      syn_options->cookie = peer_options.cookie;
       printf("Connection established\n");
       break;
+    } else if (recv_retval != TIMEOUT) {
+      return recv_retval;
     }
   }
 
   return SUCCESS;
 }
 
+tcp_error_t send_window_probe(int socket_desc, unsigned short int host_udp_port,
+                              in_port_t client_port,
+                              struct sockaddr_in *server_addr,
+                              send_window_t *window) {
+
+  tcp_segment_t send_segment;
+  create_tcp_segment(client_port, host_udp_port, window->base - 1,
+                     window->receiver_isn, 0, NULL, 0, &send_segment);
+  send_segment.checksum_type = window->checksum_type;
+  return send_tcp(socket_desc, &send_segment, server_addr);
+}
+
 tcp_error_t close_connection_sender(int client_port, int server_port,
                                     int socket_desc,
                                     struct sockaddr_in *server_addr,
-                                    struct sockaddr_in *client_addr) {
+                                    struct sockaddr_in *client_addr,
+                                    rtt_estimator_t *rtt, uint32_t fin_seq,
+                                    uint64_t digest) {
 
-  char *client_message = "close connection";
+  unsigned char client_message[FIN_DIGEST_SIZE];
+  size_t message_len = write_fin_digest(digest, client_message);
   tcp_segment_t send_segment;
-  create_tcp_segment(client_port, server_port, 0, 0, FIN, client_message,
-                     strlen(client_message), &send_segment);
+  create_tcp_segment(client_port, server_port, fin_seq, 0, FIN, client_message,
+                     message_len, &send_segment);
 
-  // retry closing connection upto 10 times before giving up
-  for (int i = 0; i < 10; i++) {
+  // retry closing connection upto 10 times before giving up, a receiver that
+  // acknowledges the FIN is still writing the file and starts the count over
+  int num_retries = 0;
+  while (num_retries < 10) {
     int send_retval = send_tcp(socket_desc, &send_segment, server_addr);
     if (send_retval != SUCCESS) {
       return send_retval;
     }
 
     tcp_segment_t recv_segment;
-    int recv_retval =
-        recv_tcp_with_timeout(socket_desc, client_addr, &recv_segment);
-    if (recv_retval == RECV_FAILED || recv_retval == UNKNOWN_FAILURE) {
-      return recv_retval;
-    } else if (recv_retval == SUCCESS && recv_segment.flags == (FIN | ACK)) {
+    int recv_retval = wait_for_fin_ack(socket_desc, client_addr, fin_seq, rtt,
+                                       &recv_segment);
+    if (recv_retval == SUCCESS) {
       printf("Connection closed\n");
-      break;
+      return SUCCESS;
+    } else if (recv_retval == CONNECTION_RESET) {
+      // the reason tells a corrupted file or a failed write apart from a
+      // receiver that was closed early
+      switch (read_rst_reason(&recv_segment)) {
+      case RST_REASON_DIGEST_MISMATCH:
+        return DIGEST_MISMATCH;
+      case RST_REASON_WRITE_FAILED:
+        return WRITE_FAILED;
+      default:
+        return CONNECTION_RESET;
+      }
+    } else if (recv_retval == WOULD_BLOCK) {
+      num_retries = 0;
+    } else if (recv_retval == TIMEOUT) {
+      num_retries++;
+    } else {
+      return recv_retval;
     }
   }
 
-  return SUCCESS;
+  // without a FIN-ACK the receiver never confirmed the digest
+  return TIMEOUT;
 }
 
-int main(int argc, char **argv) {
-  int host_udp_port;
-  char *hostname = NULL;
-  char *filename_to_xfer = NULL;
-  unsigned long long int bytes_to_xfer;
+tcp_error_t wait_for_fin_ack(int socket_desc, struct sockaddr_in *client_addr,
+                             uint32_t fin_seq, rtt_estimator_t *rtt,
+                             tcp_segment_t *recv_segment) {
+
+  uint64_t deadline_us = get_time_us() + rtt->rto_us;
+  int fin_acked = 0;
+  while (1) {
+    uint64_t now = get_time_us();
+    if (now >= deadline_us) {
+      // the FIN is sent again less often while the receiver writes
+      backoff_rto(rtt);
+      return fin_acked ? WOULD_BLOCK : TIMEOUT;
+    }
 
-  if (argc != 5) {
-    fprintf(stderr,
-            "usage: %s receiver_hostname receiver_port filename_to_xfer "
-            "bytes_to_xfer\n\n",
-            argv[0]);
-    exit(1);
+    int recv_retval = recv_tcp_with_timeout(socket_desc, client_addr,
+                                            recv_segment, deadline_us - now);
+    if (recv_retval == RECV_FAILED || recv_retval == UNKNOWN_FAILURE) {
+      return recv_retval;
+    } else if (recv_retval == SUCCESS && recv_segment->flags == RST) {
+      return CONNECTION_RESET;
+    } else if (recv_retval == SUCCESS && recv_segment->flags == (FIN | ACK)) {
+      long sample_us = rtt_sample_from_echo(recv_segment->ts_ecr);
+      if (sample_us >= 0) {
+        update_rtt_estimator(rtt, sample_us);
+      }
+      return SUCCESS;
+    } else if (recv_retval == SUCCESS && recv_segment->flags == ACK &&
+               recv_segment->ack_number == fin_seq + 1) {
+      fin_acked = 1;
+    }
+    // anything else, like a late ACK for data, is not the answer
   }
+}
 
-  hostname = argv[1];
-  host_udp_port = (unsigned short int)atoi(argv[2]);
-  filename_to_xfer = argv[3];
-  bytes_to_xfer = atoll(argv[4]);
+tcp_error_t wait_for_flags(int socket_desc, struct sockaddr_in *client_addr,
+                           uint8_t flags, rtt_estimator_t *rtt,
+                           tcp_segment_t *recv_segment) {
 
-  rsend(hostname, host_udp_port, filename_to_xfer, bytes_to_xfer);
-  return (EXIT_SUCCESS);
+  uint64_t deadline_us = get_time_us() + rtt->rto_us;
+  while (1) {
+    uint64_t now = get_time_us();
+    if (now >= deadline_us) {
+      backoff_rto(rtt);
+      return TIMEOUT;
+    }
+
+    int recv_retval = recv_tcp_with_timeout(socket_desc, client_addr,
+                                            recv_segment, deadline_us - now);
+    if (recv_retval == RECV_FAILED || recv_retval == UNKNOWN_FAILURE) {
+      return recv_retval;
+    } else if (recv_retval == SUCCESS && recv_segment->flags == RST) {
+      return CONNECTION_RESET;
+    } else if (recv_retval == SUCCESS && recv_segment->flags == flags) {
+      long sample_us = rtt_sample_from_echo(recv_segment->ts_ecr);
+      if (sample_us >= 0) {
+        update_rtt_estimator(rtt, sample_us);
+      }
+      return SUCCESS;
+    }
+    // anything else, like a late ACK for data, is not the answer
+  }
 }
@@ -0,0 +1,142 @@
+/**
+ * @file sender_main.c
+ *
+ * @brief Command line client that sends a file with libtcpudp
+ *
+ * The main() function parses the options of the sender and sends a file to a
+ * receiver with rsend_with_options(), using a UDP socket. With -f it sends
+ * every file named on the command line over one session with send_session().
+ *
+ * @author Ritam Singal (ritamsingal)
+ * @author Harshil Patel (harshil-patel11)
+ * @bug No known bugs
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include "../include/sender.h"
+#include "../include/session.h"
+#include "../include/utils.h"
+
+int main(int argc, char **argv) {
+  int host_udp_port;
+  char *hostname = NULL;
+  char *filename_to_xfer = NULL;
+  unsigned long long int bytes_to_xfer;
+
+  sender_options_t options;
+  init_sender_options(&options);
+  int session = 0;
+
+  int opt;
+  while ((opt = getopt(argc, argv, "gc:W:m:pOMe:S:k:T:b:f")) != -1) {
+    switch (opt) {
+    case 'g':
+      options.retransmit_mode = GO_BACK_N;
+      break;
+    case 'c':
+      if (parse_cc_algorithm(optarg, &options.cc_algorithm) < 0) {
+        fprintf(stderr, "unknown congestion control: %s\n", optarg);
+        argc = 0;
+      }
+      break;
+    case 'W':
+      options.max_window = MAX(1, atol(optarg));
+      break;
+    case 'm':
+      options.segment_size =
+          MAX(MIN(atol(optarg), MAX_SEGMENT_DATA_SIZE), MIN_SEGMENT_DATA_SIZE);
+      break;
+    case 'p':
+      options.probe_path_mtu = 1;
+      break;
+    case 'O':
+      options.offload = 1;
+      break;
+    case 'M':
+      options.map_file = 1;
+      break;
+    case 'e':
+      if (parse_io_engine(optarg, &options.io_engine) < 0) {
+        fprintf(stderr, "unknown I/O engine: %s\n", optarg);
+        argc = 0;
+      }
+      break;
+    case 'S':
+      options.num_streams = MAX(MIN(atol(optarg), MAX_STREAMS), 1);
+      break;
+    case 'k':
+      if (parse_checksum_type(optarg, &options.checksum_type) < 0) {
+        fprintf(stderr, "unknown checksum: %s\n", optarg);
+        argc = 0;
+      }
+      break;
+    case 'T':
+      options.cookie_file = optarg;
+      break;
+    case 'b':
+      options.max_rate = MAX(atof(optarg), 0) * 1e6 / 8;
+      break;
+    case 'f':
+      session = 1;
+      break;
+    default:
+      argc = 0;
+      break;
+    }
+  }
+
+  if (session ? argc - optind < 3 : argc - optind != 4) {
+    fprintf(stderr,
+            "usage: %s [-g] [-c aimd|cubic|bbr] [-W segments] [-m bytes] [-p] "
+            "[-O] [-M] [-e mmsg|uring] [-S streams] [-k internet|crc32c] "
+            "[-T cookie_file] [-b mbit_per_s] receiver_hostname receiver_port "
+            "filename_to_xfer bytes_to_xfer\n"
+            "       %s -f [options] receiver_hostname receiver_port "
+            "filename_to_xfer...\n"
+            "  -g  go-back-n retransmission instead of selective repeat\n"
+            "  -c  congestion control algorithm (default aimd)\n"
+            "  -W  largest window in segments (default %d)\n"
+            "  -m  segment payload size proposed to the receiver "
+            "(default %d)\n"
+            "  -p  propose the segment size that fits the path MTU\n"
+            "  -O  send trains of segments with UDP GSO\n"
+            "  -M  send straight from a memory map of the file\n"
+            "  -e  system calls the segments are moved with (default mmsg)\n"
+            "  -S  stripe the file over this many connections, each sent from "
+            "its own thread (default 1)\n"
+            "  -k  checksum proposed for the data segments "
+            "(default internet)\n"
+            "  -T  send the first window behind the SYN with the fast open "
+            "cookie kept for the receiver in this file\n"
+            "  -b  cap the rate of the transfer in Mbit/s, headers included "
+            "(default no cap)\n"
+            "  -f  send every file whole over one session, which the receiver "
+            "writes to its directory\n\n",
+            argv[0], argv[0], DEFAULT_MAX_WINDOW, DEFAULT_SEGMENT_DATA_SIZE);
+    exit(1);
+  }
+
+  hostname = argv[optind];
+  host_udp_port = (unsigned short int)atoi(argv[optind + 1]);
+  if (session) {
+    int num_files = argc - optind - 2;
+    int num_sent = send_session(hostname, host_udp_port, argv + optind + 2,
+                                num_files, &options);
+    if (num_sent < 0) {
+      return (EXIT_FAILURE);
+    }
+    printf("Sent %d of %d files\n", num_sent, num_files);
+    return (EXIT_SUCCESS);
+  }
+  filename_to_xfer = argv[optind + 2];
+  bytes_to_xfer = atoll(argv[optind + 3]);
+
+  if (rsend_with_options(hostname, host_udp_port, filename_to_xfer,
+                         bytes_to_xfer, &options) != SUCCESS) {
+    return (EXIT_FAILURE);
+  }
+  return (EXIT_SUCCESS);
+}
@@ -0,0 +1,376 @@
+/**
+ * @file session.c
+ *
+ * @brief Function definitions for sessions that carry many files
+ *
+ * This file contains the function definitions for sending many files over
+ * one connection of libtcpudp and for writing them to a directory on the
+ * receiver. The sender packs each header with the start of its file, so
+ * small files cost one send call and no handshake.
+ *
+ * @author Ritam Singal (ritamsingal)
+ * @author Harshil Patel (harshil-patel11)
+ * @bug No known bugs
+ */
+
+#include <arpa/inet.h>
+#include <endian.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <poll.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <unistd.h>
+
+#include "../include/session.h"
+#include "../include/utils.h"
+
+size_t write_session_header(session_file_header_t *header,
+                            unsigned char *data) {
+  uint64_t size = htobe64(header->size);
+  uint32_t mode = htonl(header->mode);
+  uint16_t name_len = htons(header->name_len);
+  memcpy(data, &size, sizeof(size));
+  memcpy(data + 8, &mode, sizeof(mode));
+  memcpy(data + 12, &name_len, sizeof(name_len));
+  memcpy(data + SESSION_HEADER_SIZE, header->name, header->name_len);
+  return SESSION_HEADER_SIZE + header->name_len;
+}
+
+int read_session_header(const unsigned char *data,
+                        session_file_header_t *header) {
+  uint64_t size;
+  uint32_t mode;
+  uint16_t name_len;
+  memcpy(&size, data, sizeof(size));
+  memcpy(&mode, data + 8, sizeof(mode));
+  memcpy(&name_len, data + 12, sizeof(name_len));
+  header->size = be64toh(size);
+  header->mode = ntohl(mode);
+  header->name_len = ntohs(name_len);
+  if (header->name_len == 0 || header->name_len > MAX_SESSION_NAME) {
+    return -1;
+  }
+  return 0;
+}
+
+int send_session(char *hostname, unsigned short int port, char **filenames,
+                 int num_files, sender_options_t *options) {
+  tcpudp_conn_t *conn = tcpudp_connect(hostname, port, options);
+  if (conn == NULL) {
+    return -1;
+  }
+
+  char *data = malloc(SESSION_CHUNK_SIZE);
+  if (data == NULL) {
+    printf("Couldn't allocate session buffer\n");
+    tcpudp_close(conn);
+    return -1;
+  }
+
+  int num_sent = 0;
+  for (int i = 0; i < num_files; i++) {
+    int retval = send_session_file(conn, filenames[i], data);
+    if (retval < 0) {
+      printf("Session failed while sending %s\n", filenames[i]);
+      free(data);
+      tcpudp_close(conn);
+      return -1;
+    }
+    num_sent += retval;
+  }
+  free(data);
+
+  if (tcpudp_close(conn) != SUCCESS) {
+    printf("Couldn't close session\n");
+    return -1;
+  }
+  return num_sent;
+}
+
+int send_session_file(tcpudp_conn_t *conn, char *filename, char *data) {
+  session_file_header_t header;
+  char *name = strrchr(filename, '/');
+  name = name != NULL ? name + 1 : filename;
+  size_t name_len = strlen(name);
+  if (name_len == 0 || name_len > MAX_SESSION_NAME) {
+    printf("Invalid file name %s, skipped\n", filename);
+    return 0;
+  }
+
+  int file_desc = open(filename, O_RDONLY);
+  if (file_desc < 0) {
+    printf("Couldn't open file %s, skipped\n", filename);
+    return 0;
+  }
+  struct stat file_stat;
+  if (fstat(file_desc, &file_stat) < 0 || !S_ISREG(file_stat.st_mode)) {
+    printf("Not a regular file %s, skipped\n", filename);
+    close(file_desc);
+    return 0;
+  }
+
+  header.size = file_stat.st_size;
+  header.mode = file_stat.st_mode & 0777;
+  header.name_len = name_len;
+  memcpy(header.name, name, name_len);
+
+  // the header shares the first chunk with the start of the file
+  size_t chunk_len = write_session_header(&header, (unsigned char *)data);
+  uint64_t bytes_left = header.size;
+  do {
+    size_t read_len = MIN(bytes_left, SESSION_CHUNK_SIZE - chunk_len);
+    ssize_t num_read = read(file_desc, data + chunk_len, read_len);
+    if (num_read < 0 && errno == EINTR) {
+      continue;
+    }
+    // once the header is sent the receiver expects every byte it announced
+    if (num_read <= 0 && read_len > 0) {
+      printf("Couldn't read file %s\n", filename);
+      close(file_desc);
+      return UNKNOWN_FAILURE;
+    }
+    chunk_len += num_read;
+    bytes_left -= num_read;
+
+    int retval = send_session_bytes(conn, data, chunk_len);
+    if (retval != SUCCESS) {
+      close(file_desc);
+      return retval;
+    }
+    chunk_len = 0;
+  } while (bytes_left > 0);
+
+  close(file_desc);
+  return 1;
+}
+
+int send_session_bytes(tcpudp_conn_t *conn, const char *data, size_t len) {
+  while (len > 0) {
+    ssize_t num_sent = tcpudp_send(conn, data, len);
+    if (num_sent == WOULD_BLOCK) {
+      // the ACKs that free the buffer make the connection readable
+      struct pollfd poll_fd = {.fd = tcpudp_fileno(conn), .events = POLLIN};
+      if (poll(&poll_fd, 1, -1) < 0 && errno != EINTR) {
+        return UNKNOWN_FAILURE;
+      }
+      continue;
+    }
+    if (num_sent < 0) {
+      return num_sent;
+    }
+    data += num_sent;
+    len -= num_sent;
+  }
+  return SUCCESS;
+}
+
+int receive_sessions(unsigned short int port, char *directory,
+                     receiver_options_t *options) {
+  // without -s the listener serves the first session only
+  receiver_options_t listener_options = *options;
+  if (!options->server) {
+    listener_options.max_connections = 1;
+  }
+  uint32_t max_sessions = listener_options.max_connections;
+
+  tcpudp_listener_t *listener = tcpudp_listen(port, &listener_options);
+  if (listener == NULL) {
+    return -1;
+  }
+
+  session_receiver_t *sessions =
+      calloc(max_sessions, sizeof(session_receiver_t));
+  char *data = malloc(SESSION_CHUNK_SIZE);
+  if (sessions == NULL || data == NULL) {
+    printf("Couldn't allocate sessions\n");
+    free(sessions);
+    free(data);
+    tcpudp_close_listener(listener);
+    return -1;
+  }
+
+  // segments and timers of every session make the listener readable
+  uint32_t num_sessions = 0;
+  int retval = 0;
+  int done = 0;
+  while (!done) {
+    struct pollfd poll_fd = {.fd = tcpudp_listener_fileno(listener),
+                             .events = POLLIN};
+    if (poll(&poll_fd, 1, -1) < 0 && errno != EINTR) {
+      printf("Error while waiting for sessions\n");
+      retval = -1;
+      break;
+    }
+
+    tcpudp_conn_t *conn;
+    while (num_sessions < max_sessions &&
+           (conn = tcpudp_accept(listener)) != NULL) {
+      session_receiver_t *session = &sessions[num_sessions++];
+      memset(session, 0, sizeof(*session));
+      session->conn = conn;
+      session->directory = directory;
+      session->file_desc = -1;
+    }
+
+    uint32_t i = 0;
+    while (i < num_sessions) {
+      session_receiver_t *session = &sessions[i];
+      int session_retval = receive_session_data(session, data);
+      if (session_retval == EVENT_CONTINUE) {
+        i++;
+        continue;
+      }
+
+      struct sockaddr_in *addr = &session->conn->connection->addr;
+      if (session_retval == EVENT_STOP) {
+        printf("Received %u files from %s:%d\n", session->num_files,
+               inet_ntoa(addr->sin_addr), ntohs(addr->sin_port));
+      } else {
+        printf("Session from %s:%d failed after %u files\n",
+               inet_ntoa(addr->sin_addr), ntohs(addr->sin_port),
+               session->num_files);
+        retval = -1;
+      }
+      if (session->file_desc >= 0) {
+        close(session->file_desc);
+      }
+      tcpudp_close(session->conn);
+      sessions[i] = sessions[--num_sessions];
+      done = !options->server;
+    }
+  }
+
+  for (uint32_t i = 0; i < num_sessions; i++) {
+    if (sessions[i].file_desc >= 0) {
+      close(sessions[i].file_desc);
+    }
+    tcpudp_close(sessions[i].conn);
+  }
+  free(sessions);
+  free(data);
+  tcpudp_close_listener(listener);
+  return retval;
+}
+
+int receive_session_data(session_receiver_t *session, char *data) {
+  while (1) {
+    ssize_t num_read = tcpudp_recv(session->conn, data, SESSION_CHUNK_SIZE);
+    if (num_read == WOULD_BLOCK) {
+      return EVENT_CONTINUE;
+    }
+    if (num_read < 0) {
+      return num_read;
+    }
+    if (num_read == 0) {
+      // a session may only end between two files
+      if (session->file_desc >= 0 || session->header_len > 0) {
+        printf("Session ended inside a file\n");
+        return UNKNOWN_FAILURE;
+      }
+      return EVENT_STOP;
+    }
+    if (write_session_data(session, data, num_read) < 0) {
+      return WRITE_FAILED;
+    }
+  }
+}
+
+int write_session_data(session_receiver_t *session, const char *data,
+                       size_t len) {
+  while (len > 0) {
+    if (session->file_desc < 0) {
+      // the name follows the fixed part once its length is known
+      size_t header_size = SESSION_HEADER_SIZE;
+      if (session->header_len >= SESSION_HEADER_SIZE) {
+        header_size += session->file.name_len;
+      }
+      size_t chunk = MIN(header_size - session->header_len, len);
+      memcpy(session->header + session->header_len, data, chunk);
+      session->header_len += chunk;
+      data += chunk;
+      len -= chunk;
+      if (session->header_len < header_size) {
+        continue;
+      }
+      if (header_size == SESSION_HEADER_SIZE) {
+        if (read_session_header(session->header, &session->file) < 0) {
+          printf("Invalid file header\n");
+          return -1;
+        }
+        continue;
+      }
+
+      memcpy(session->file.name, session->header + SESSION_HEADER_SIZE,
+             session->file.name_len);
+      session->file.name[session->file.name_len] = '\0';
+      session->header_len = 0;
+      if (open_session_file(session) < 0) {
+        return -1;
+      }
+      if (session->bytes_left == 0 && close_session_file(session) < 0) {
+        return -1;
+      }
+      continue;
+    }
+
+    size_t chunk = MIN(session->bytes_left, len);
+    ssize_t num_written = write(session->file_desc, data, chunk);
+    if (num_written < 0 && errno == EINTR) {
+      continue;
+    }
+    if (num_written < 0) {
+      printf("Couldn't write file %s\n", session->file.name);
+      return -1;
+    }
+    data += num_written;
+    len -= num_written;
+    session->bytes_left -= num_written;
+    if (session->bytes_left == 0 && close_session_file(session) < 0) {
+      return -1;
+    }
+  }
+  return 0;
+}
+
+int open_session_file(session_receiver_t *session) {
+  // names come from the network, so they may not leave the directory
+  char *name = session->file.name;
+  if (strchr(name, '/') != NULL || strcmp(name, ".") == 0 ||
+      strcmp(name, "..") == 0) {
+    printf("Invalid file name %s\n", name);
+    return -1;
+  }
+
+  char path[PATH_MAX];
+  if (snprintf(path, sizeof(path), "%s/%s", session->directory, name) >=
+      (int)sizeof(path)) {
+    printf("File path too long for %s\n", name);
+    return -1;
+  }
+  session->file_desc = open(path, O_WRONLY | O_CREAT | O_TRUNC, 0600);
+  if (session->file_desc < 0) {
+    printf("Couldn't open file %s\n", path);
+    return -1;
+  }
+  session->bytes_left = session->file.size;
+  return 0;
+}
+
+int close_session_file(session_receiver_t *session) {
+  // the mode is set last, so a read-only file can still be written
+  int retval = fchmod(session->file_desc, session->file.mode & 0777);
+  if (close(session->file_desc) < 0 || retval < 0) {
+    printf("Couldn't close file %s\n", session->file.name);
+    session->file_desc = -1;
+    return -1;
+  }
+  session->file_desc = -1;
+  session->num_files++;
+  return 0;
+}
@@ -0,0 +1,528 @@
+/**
+ * @file tcp_io.c
+ * @brief Function definitions for sending and receiving TCP segments in
+ * batches
+ *
+ * This file contains the function definitions for queueing TCP segments and
+ * sending them with a single sendmmsg call, and for draining every segment
+ * waiting on a socket with a single recvmmsg call. On Linux the batch can also
+ * hand trains of equal-sized segments to the kernel as one UDP GSO buffer and
+ * take coalesced trains back with UDP GRO. With the io_uring engine the
+ * datagrams of a batch and the file writes of the receiver are submitted to an
+ * io_uring instance instead, and moved with one system call.
+ *
+ * @author Ritam Singal (ritamsingal)
+ * @author Harshil Patel (harshil-patel11)
+ * @bug No known bugs
+ */
+
+#define _GNU_SOURCE
+
+#include <errno.h>
+#include <netinet/udp.h>
+#include <poll.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include "../include/tcp_io.h"
+#include "../include/utils.h"
+
+// room for the one control message carrying a GSO or GRO segment size
+#define IO_CONTROL_SIZE CMSG_SPACE(sizeof(int))
+
+// io_uring completions carry the kind of entry and its message or buffer
+#define URING_SEND 0
+#define URING_RECV 1
+#define URING_TIMEOUT 2
+#define URING_WRITE 3
+#define URING_TAG(kind, index) (((uint64_t)(kind) << 32) | (uint32_t)(index))
+
+int init_tcp_io(tcp_io_t *io, int socket_desc, int capacity, int offload,
+                io_engine_t engine) {
+  // both directions have to be supported, a socket sends and receives trains
+  int enable = 1;
+  int gso_size = 0;
+  if (offload &&
+      (setsockopt(socket_desc, SOL_UDP, UDP_SEGMENT, &gso_size,
+                  sizeof(gso_size)) < 0 ||
+       setsockopt(socket_desc, SOL_UDP, UDP_GRO, &enable, sizeof(enable)) <
+           0)) {
+    offload = 0;
+  }
+
+  io->socket_desc = socket_desc;
+  io->capacity = capacity;
+  io->num_queued = 0;
+  io->num_received = 0;
+  io->offload = offload;
+  io->segments_per_message = offload ? GSO_MAX_SEGMENTS : 1;
+  io->message_size = offload ? GSO_MESSAGE_SIZE : MAX_WIRE_SEGMENT_SIZE;
+  io->next_message = 0;
+  io->next_offset = 0;
+  io->engine = IO_ENGINE_MMSG;
+  io->write_buffers = NULL;
+  io->write_lens = NULL;
+  io->num_writes = 0;
+  io->num_pending = 0;
+  io->timed_out = 0;
+  io->uring_error = SUCCESS;
+  size_t num_slots = (size_t)capacity * io->segments_per_message;
+  io->buffers = malloc((size_t)capacity * io->message_size);
+  io->headers = malloc(num_slots * MAX_WIRE_HEADER_SIZE);
+  io->control = calloc(capacity, IO_CONTROL_SIZE);
+  io->msgs = calloc(capacity, sizeof(struct mmsghdr));
+  io->iovecs = calloc(capacity, sizeof(struct iovec));
+  io->send_iovecs = calloc(2 * num_slots, sizeof(struct iovec));
+  io->addrs = calloc(capacity, sizeof(struct sockaddr_in));
+  io->gso_sizes = calloc(capacity, sizeof(uint16_t));
+  io->num_segments = calloc(capacity, sizeof(int));
+  io->message_lens = calloc(capacity, sizeof(size_t));
+  if (io->buffers == NULL || io->headers == NULL || io->control == NULL ||
+      io->msgs == NULL || io->iovecs == NULL || io->send_iovecs == NULL ||
+      io->addrs == NULL || io->gso_sizes == NULL || io->num_segments == NULL ||
+      io->message_lens == NULL) {
+    free_tcp_io(io);
+    return -1;
+  }
+
+  for (int i = 0; i < capacity; i++) {
+    io->iovecs[i].iov_base = io->buffers + (size_t)i * io->message_size;
+    io->msgs[i].msg_hdr.msg_name = &io->addrs[i];
+  }
+
+  if (engine == IO_ENGINE_URING) {
+    size_t write_buffers_size = (size_t)capacity * MAX_SEGMENT_DATA_SIZE;
+    io->write_buffers = malloc(write_buffers_size);
+    io->write_lens = calloc(capacity, sizeof(size_t));
+    if (io->write_buffers == NULL || io->write_lens == NULL) {
+      free_tcp_io(io);
+      return -1;
+    }
+    // the largest submission is a receive per message, the timeout of the
+    // first, and a write per buffer
+    if (init_tcp_uring(&io->ring, 2 * capacity + 2) == 0 &&
+        register_uring_buffer(&io->ring, io->write_buffers,
+                              write_buffers_size) == 0) {
+      io->engine = IO_ENGINE_URING;
+    } else {
+      free_tcp_uring(&io->ring);
+    }
+  }
+  return 0;
+}
+
+int parse_io_engine(const char *name, io_engine_t *engine) {
+  if (strcmp(name, "mmsg") == 0) {
+    *engine = IO_ENGINE_MMSG;
+  } else if (strcmp(name, "uring") == 0) {
+    *engine = IO_ENGINE_URING;
+  } else {
+    return -1;
+  }
+  return 0;
+}
+
+void free_tcp_io(tcp_io_t *io) {
+  free(io->buffers);
+  free(io->headers);
+  free(io->control);
+  free(io->msgs);
+  free(io->iovecs);
+  free(io->send_iovecs);
+  free(io->addrs);
+  free(io->gso_sizes);
+  free(io->num_segments);
+  free(io->message_lens);
+  free(io->write_buffers);
+  free(io->write_lens);
+  if (io->engine == IO_ENGINE_URING) {
+    free_tcp_uring(&io->ring);
+    io->engine = IO_ENGINE_MMSG;
+  }
+  io->buffers = NULL;
+  io->headers = NULL;
+  io->control = NULL;
+  io->msgs = NULL;
+  io->iovecs = NULL;
+  io->send_iovecs = NULL;
+  io->addrs = NULL;
+  io->gso_sizes = NULL;
+  io->num_segments = NULL;
+  io->message_lens = NULL;
+  io->write_buffers = NULL;
+  io->write_lens = NULL;
+}
+
+int can_extend_train(tcp_io_t *io, size_t length,
+                     struct sockaddr_in *server_addr) {
+  if (!io->offload || io->num_queued == 0) {
+    return 0;
+  }
+  int i = io->num_queued - 1;
+  // only the last segment of a train may be shorter than the others
+  return io->num_segments[i] < io->segments_per_message &&
+         io->message_lens[i] ==
+             (size_t)io->num_segments[i] * io->gso_sizes[i] &&
+         length <= io->gso_sizes[i] &&
+         io->message_lens[i] + length <= GSO_MAX_MESSAGE &&
+         io->addrs[i].sin_addr.s_addr == server_addr->sin_addr.s_addr &&
+         io->addrs[i].sin_port == server_addr->sin_port;
+}
+
+int reserve_tcp_message(tcp_io_t *io, size_t length,
+                        struct sockaddr_in *server_addr) {
+  if (can_extend_train(io, length, server_addr)) {
+    return io->num_queued - 1;
+  }
+
+  if (io->num_queued == io->capacity && flush_tcp(io) != SUCCESS) {
+    return -1;
+  }
+
+  int i = io->num_queued++;
+  io->addrs[i] = *server_addr;
+  io->gso_sizes[i] = length;
+  io->num_segments[i] = 0;
+  io->message_lens[i] = 0;
+  return i;
+}
+
+tcp_error_t queue_tcp(tcp_io_t *io, tcp_segment_t *send_segment,
+                      struct sockaddr_in *server_addr) {
+  return queue_tcp_payload(io, send_segment, NULL, server_addr);
+}
+
+tcp_error_t queue_tcp_payload(tcp_io_t *io, tcp_segment_t *send_segment,
+                              const char *payload,
+                              struct sockaddr_in *server_addr) {
+  size_t length = tcp_header_length(send_segment) + send_segment->data_len;
+  int i = reserve_tcp_message(io, length, server_addr);
+  if (i < 0) {
+    return SEND_FAILED;
+  }
+
+  // the payloads copied into a message never outgrow its buffer
+  if (payload == NULL) {
+    char *copy = (char *)io->buffers + (size_t)i * io->message_size +
+                 io->message_lens[i];
+    memcpy(copy, send_segment->data, send_segment->data_len);
+    payload = copy;
+  }
+
+  size_t slot = (size_t)i * io->segments_per_message + io->num_segments[i]++;
+  unsigned char *header = io->headers + slot * MAX_WIRE_HEADER_SIZE;
+  struct iovec *iovecs = &io->send_iovecs[2 * slot];
+  iovecs[0].iov_base = header;
+  iovecs[0].iov_len = encode_tcp_header(send_segment, payload, header);
+  iovecs[1].iov_base = (char *)payload;
+  iovecs[1].iov_len = send_segment->data_len;
+  io->message_lens[i] += length;
+  return SUCCESS;
+}
+
+tcp_error_t flush_tcp(tcp_io_t *io) {
+  // trains tell the kernel where to split them
+  for (int i = 0; i < io->num_queued; i++) {
+    struct msghdr *msg = &io->msgs[i].msg_hdr;
+    msg->msg_namelen = sizeof(io->addrs[i]);
+    msg->msg_iov =
+        &io->send_iovecs[2 * (size_t)i * io->segments_per_message];
+    msg->msg_iovlen = 2 * io->num_segments[i];
+    msg->msg_control = NULL;
+    msg->msg_controllen = 0;
+    if (io->num_segments[i] > 1) {
+      msg->msg_control = io->control + (size_t)i * IO_CONTROL_SIZE;
+      msg->msg_controllen = CMSG_SPACE(sizeof(uint16_t));
+      struct cmsghdr *cmsg = CMSG_FIRSTHDR(msg);
+      cmsg->cmsg_level = SOL_UDP;
+      cmsg->cmsg_type = UDP_SEGMENT;
+      cmsg->cmsg_len = CMSG_LEN(sizeof(uint16_t));
+      memcpy(CMSG_DATA(cmsg), &io->gso_sizes[i], sizeof(uint16_t));
+    }
+  }
+
+  if (io->engine == IO_ENGINE_URING) {
+    return send_tcp_uring(io);
+  }
+
+  int num_sent = 0;
+  while (num_sent < io->num_queued) {
+    int retval = sendmmsg(io->socket_desc, io->msgs + num_sent,
+                          io->num_queued - num_sent, 0);
+    if (retval < 0) {
+      io->num_queued = 0;
+      return SEND_FAILED;
+    }
+    num_sent += retval;
+  }
+  io->num_queued = 0;
+  return SUCCESS;
+}
+
+int recv_tcp_batch(tcp_io_t *io, long timeout_us) {
+  io->num_received = 0;
+  io->next_message = 0;
+  io->next_offset = 0;
+
+  for (int i = 0; i < io->capacity; i++) {
+    struct msghdr *msg = &io->msgs[i].msg_hdr;
+    io->iovecs[i].iov_len = io->message_size;
+    msg->msg_iov = &io->iovecs[i];
+    msg->msg_iovlen = 1;
+    msg->msg_namelen = sizeof(io->addrs[i]);
+    msg->msg_control = io->offload ? io->control + (size_t)i * IO_CONTROL_SIZE
+                                   : NULL;
+    msg->msg_controllen = io->offload ? IO_CONTROL_SIZE : 0;
+  }
+
+  int num_received;
+  if (io->engine == IO_ENGINE_URING) {
+    num_received = recv_tcp_uring(io, timeout_us);
+    if (num_received < 0) {
+      return num_received;
+    }
+  } else {
+    // a caller driven by an event loop already knows the socket is ready
+    int flags = MSG_WAITFORONE;
+    if (timeout_us >= 0) {
+      flags = MSG_DONTWAIT;
+    }
+    if (timeout_us > 0) {
+      struct pollfd fds = {.fd = io->socket_desc, .events = POLLIN};
+      int activity = poll(&fds, 1, (timeout_us + 999) / 1000);
+      if (activity == -1) {
+        return UNKNOWN_FAILURE;
+      } else if (activity == 0) {
+        return TIMEOUT;
+      }
+    }
+
+    num_received =
+        recvmmsg(io->socket_desc, io->msgs, io->capacity, flags, NULL);
+    if (num_received < 0) {
+      return errno == EAGAIN || errno == EWOULDBLOCK ? TIMEOUT : RECV_FAILED;
+    }
+  }
+
+  // coalesced trains carry the size of their segments
+  for (int i = 0; i < num_received; i++) {
+    struct msghdr *msg = &io->msgs[i].msg_hdr;
+    io->gso_sizes[i] = 0;
+    for (struct cmsghdr *cmsg = io->offload ? CMSG_FIRSTHDR(msg) : NULL;
+         cmsg != NULL; cmsg = CMSG_NXTHDR(msg, cmsg)) {
+      if (cmsg->cmsg_level == SOL_UDP && cmsg->cmsg_type == UDP_GRO) {
+        int gso_size;
+        memcpy(&gso_size, CMSG_DATA(cmsg), sizeof(gso_size));
+        io->gso_sizes[i] = gso_size;
+      }
+    }
+  }
+  io->num_received = num_received;
+  return num_received;
+}
+
+tcp_error_t send_tcp_uring(tcp_io_t *io) {
+  tcp_error_t retval = SUCCESS;
+  for (int i = 0; i < io->num_queued; i++) {
+    struct io_uring_sqe *sqe = acquire_uring_sqe(&io->ring);
+    if (sqe == NULL) {
+      // fall back to sending this one directly
+      if (sendmsg(io->socket_desc, &io->msgs[i].msg_hdr, 0) < 0) {
+        retval = SEND_FAILED;
+      }
+      continue;
+    }
+    sqe->opcode = IORING_OP_SENDMSG;
+    sqe->fd = io->socket_desc;
+    sqe->addr = (uintptr_t)&io->msgs[i].msg_hdr;
+    sqe->user_data = URING_TAG(URING_SEND, i);
+    io->num_pending++;
+  }
+  io->num_queued = 0;
+
+  if (complete_tcp_uring(io) != SUCCESS) {
+    return SEND_FAILED;
+  }
+  return io->uring_error != SUCCESS ? io->uring_error : retval;
+}
+
+int recv_tcp_uring(tcp_io_t *io, long timeout_us) {
+  struct __kernel_timespec timeout;
+  timeout.tv_sec = timeout_us / 1000000;
+  timeout.tv_nsec = timeout_us % 1000000 * 1000;
+
+  // the first receive waits for a datagram, the others only take the ones
+  // already queued; a failed link cancels the rest of the chain, so the
+  // receives stop at the first one that finds the socket empty
+  io->timed_out = 0;
+
+  // a chain is only linked within one submission, so the queued writes are
+  // submitted first, which leaves room for the whole chain
+  if (io->ring.num_prepared > 0 && submit_uring(&io->ring, 0) < 0) {
+    io->num_pending = 0;
+    io->num_writes = 0;
+    return UNKNOWN_FAILURE;
+  }
+
+  for (int i = 0; i < io->capacity; i++) {
+    struct io_uring_sqe *sqe = acquire_uring_sqe(&io->ring);
+    if (sqe == NULL) {
+      complete_tcp_uring(io);
+      return UNKNOWN_FAILURE;
+    }
+    int has_timeout = i == 0 && timeout_us > 0;
+    sqe->opcode = IORING_OP_RECVMSG;
+    sqe->fd = io->socket_desc;
+    sqe->addr = (uintptr_t)&io->msgs[i].msg_hdr;
+    sqe->msg_flags = i > 0 || timeout_us == 0 ? MSG_DONTWAIT : 0;
+    // the timeout applies to the entry linked right before it
+    sqe->flags = has_timeout || i + 1 < io->capacity ? IOSQE_IO_LINK : 0;
+    sqe->user_data = URING_TAG(URING_RECV, i);
+    io->num_pending++;
+
+    if (has_timeout) {
+      sqe = acquire_uring_sqe(&io->ring);
+      if (sqe == NULL) {
+        complete_tcp_uring(io);
+        return UNKNOWN_FAILURE;
+      }
+      sqe->opcode = IORING_OP_LINK_TIMEOUT;
+      sqe->addr = (uintptr_t)&timeout;
+      sqe->len = 1;
+      sqe->flags = i + 1 < io->capacity ? IOSQE_IO_LINK : 0;
+      sqe->user_data = URING_TAG(URING_TIMEOUT, 0);
+      io->num_pending++;
+    }
+  }
+
+  if (complete_tcp_uring(io) != SUCCESS) {
+    return UNKNOWN_FAILURE;
+  } else if (io->uring_error != SUCCESS) {
+    return io->uring_error;
+  } else if (io->timed_out || (timeout_us == 0 && io->num_received == 0)) {
+    return TIMEOUT;
+  }
+  return io->num_received;
+}
+
+tcp_error_t complete_tcp_uring(tcp_io_t *io) {
+  io->uring_error = SUCCESS;
+  if (io->num_pending == 0) {
+    return SUCCESS;
+  }
+  if (submit_uring(&io->ring, io->num_pending) < 0) {
+    io->num_pending = 0;
+    io->num_writes = 0;
+    return UNKNOWN_FAILURE;
+  }
+
+  while (io->num_pending > 0) {
+    struct io_uring_cqe cqe;
+    if (!next_uring_cqe(&io->ring, &cqe)) {
+      // only reached if the wait returned early
+      if (submit_uring(&io->ring, io->num_pending) < 0) {
+        io->num_pending = 0;
+        io->num_writes = 0;
+        return UNKNOWN_FAILURE;
+      }
+      continue;
+    }
+    io->num_pending--;
+
+    int index = (uint32_t)cqe.user_data;
+    tcp_error_t error = SUCCESS;
+    switch (cqe.user_data >> 32) {
+    case URING_SEND:
+      error = cqe.res < 0 ? SEND_FAILED : SUCCESS;
+      break;
+    case URING_RECV:
+      io->msgs[index].msg_len = MAX(cqe.res, 0);
+      if (cqe.res >= 0) {
+        io->num_received = MAX(io->num_received, index + 1);
+      } else if (cqe.res != -EAGAIN && cqe.res != -ECANCELED) {
+        error = RECV_FAILED;
+      }
+      break;
+    case URING_TIMEOUT:
+      io->timed_out = cqe.res == -ETIME;
+      break;
+    case URING_WRITE:
+      error = cqe.res != (int)io->write_lens[index] ? WRITE_FAILED : SUCCESS;
+      break;
+    }
+    if (io->uring_error == SUCCESS) {
+      io->uring_error = error;
+    }
+  }
+  io->num_writes = 0;
+  return SUCCESS;
+}
+
+tcp_error_t write_tcp_file(tcp_io_t *io, int file_desc, const char *data,
+                           size_t length, off_t offset) {
+  if (io->engine != IO_ENGINE_URING) {
+    ssize_t bytes_written = pwrite(file_desc, data, length, offset);
+    return bytes_written == (ssize_t)length ? SUCCESS : WRITE_FAILED;
+  }
+
+  if (io->num_writes == io->capacity && sync_tcp_writes(io) != SUCCESS) {
+    return WRITE_FAILED;
+  }
+
+  int slot = io->num_writes++;
+  char *buffer = io->write_buffers + (size_t)slot * MAX_SEGMENT_DATA_SIZE;
+  memcpy(buffer, data, length);
+  io->write_lens[slot] = length;
+
+  struct io_uring_sqe *sqe = acquire_uring_sqe(&io->ring);
+  if (sqe == NULL) {
+    // fall back to writing this one directly
+    io->num_writes--;
+    ssize_t bytes_written = pwrite(file_desc, data, length, offset);
+    return bytes_written == (ssize_t)length ? SUCCESS : WRITE_FAILED;
+  }
+  sqe->opcode = IORING_OP_WRITE_FIXED;
+  sqe->fd = file_desc;
+  sqe->addr = (uintptr_t)buffer;
+  sqe->len = length;
+  sqe->off = offset;
+  sqe->buf_index = 0;
+  sqe->user_data = URING_TAG(URING_WRITE, slot);
+  io->num_pending++;
+  return SUCCESS;
+}
+
+tcp_error_t sync_tcp_writes(tcp_io_t *io) {
+  if (complete_tcp_uring(io) != SUCCESS || io->uring_error != SUCCESS) {
+    return WRITE_FAILED;
+  }
+  return SUCCESS;
+}
+
+int next_tcp_segment(tcp_io_t *io, tcp_segment_t *recv_segment,
+                     struct sockaddr_in *client_addr) {
+  while (io->next_message < io->num_received) {
+    int i = io->next_message;
+    size_t message_len = io->msgs[i].msg_len;
+    size_t offset = io->next_offset;
+    size_t length = message_len - offset;
+    if (io->gso_sizes[i] > 0 && io->gso_sizes[i] < length) {
+      length = io->gso_sizes[i];
+    }
+
+    io->next_offset += length;
+    if (io->next_offset >= message_len) {
+      io->next_message++;
+      io->next_offset = 0;
+    }
+
+    if (decode_tcp((unsigned char *)io->iovecs[i].iov_base + offset, length,
+                   recv_segment) == SUCCESS) {
+      *client_addr = io->addrs[i];
+      return 1;
+    }
+  }
+  return 0;
+}
@@ -4,18 +4,22 @@
  * checksum of a TCP segment
  *
  * This file contains the function definitions for creating a TCP segment,
- * calculating the checksum of a TCP segment, and comparing the checksum of a
- * TCP segment
+ * calculating the checksum of a TCP segment, comparing the checksum of a TCP
+ * segment, and converting a TCP segment to and from its wire format
  *
  * @author Ritam Singal (ritamsingal)
  * @author Harshil Patel (harshil-patel11)
  * @bug No known bugs
  */
 
+#include <arpa/inet.h>
+#include <endian.h>
+#include <stddef.h>
 #include <stdlib.h>
 #include <string.h>
 
 #include "../include/tcp_segment.h"
+#include "../include/utils.h"
 
 void create_tcp_segment(uint16_t source_port, uint16_t dest_port,
                         uint32_t seq_number, uint32_t ack_number, uint8_t flags,
@@ -26,39 +30,218 @@ void create_tcp_segment(uint16_t source_port, uint16_t dest_port,
   segment->dest_port = dest_port;
   segment->seq_number = seq_number;
   segment->ack_number = ack_number;
+  segment->window = 0;
   segment->flags = flags;
-  memset(segment->data, '\0', sizeof(segment->data));
-  memcpy(segment->data, data, data_size);
+  segment->ts_val = 0;
+  segment->ts_ecr = 0;
+  segment->num_sack_blocks = 0;
+  segment->checksum_type = CHECKSUM_INTERNET;
+  segment->data_len = MIN(data_size, MAX_SEGMENT_DATA_SIZE);
+  if (segment->data_len > 0) {
+    memcpy(segment->data, data, segment->data_len);
+  }
 
-  segment->head_len = sizeof(segment->source_port) +
-                      sizeof(segment->dest_port) + sizeof(segment->seq_number) +
-                      sizeof(segment->ack_number) + sizeof(segment->flags) +
-                      sizeof(segment->checksum);
+  segment->head_len = sizeof(tcp_header_t);
   segment->checksum = calculate_checksum(segment);
 }
 
-uint16_t calculate_checksum(tcp_segment_t *segment) {
-  uint32_t sum = 0;
-  sum += segment->source_port;
-  sum += segment->dest_port;
-  sum += segment->seq_number;
-  sum += segment->ack_number;
-  sum += segment->head_len;
-  sum += segment->flags;
-
-  for (int i = 0; i < SEGMENT_DATA_SIZE; i++) {
-    sum += segment->data[i];
-  }
+uint32_t calculate_checksum(tcp_segment_t *segment) {
+  return calculate_payload_checksum(segment, segment->data);
+}
 
-  sum = (sum & 0xFFFF) + (sum >> 16);
-  sum = ~sum;
-  return (uint16_t)sum;
+uint32_t calculate_payload_checksum(tcp_segment_t *segment,
+                                    const char *payload) {
+  // the checksum covers the header as it goes on the wire, so it is the same
+  // on hosts of either byte order
+  unsigned char header[MAX_WIRE_HEADER_SIZE];
+  size_t header_len = serialize_tcp_header(segment, header);
+  memset(header + offsetof(tcp_header_t, checksum), 0,
+         sizeof(((tcp_header_t *)0)->checksum));
+  return compute_checksum(segment->checksum_type, header, header_len, payload,
+                          segment->data_len);
 }
 
 int compare_checksum(tcp_segment_t *segment) {
-  uint16_t calculated_checksum = calculate_checksum(segment);
+  uint32_t calculated_checksum = calculate_checksum(segment);
   if (segment->checksum == calculated_checksum) {
     return 1;
   }
   return 0;
-}
\ No newline at end of file
+}
+
+size_t tcp_header_length(tcp_segment_t *segment) {
+  return sizeof(tcp_header_t) +
+         segment->num_sack_blocks * 2 * sizeof(uint32_t);
+}
+
+size_t serialize_tcp_header(tcp_segment_t *segment, unsigned char *buffer) {
+  tcp_header_t header;
+  header.source_port = htons(segment->source_port);
+  header.dest_port = htons(segment->dest_port);
+  header.seq_number = htonl(segment->seq_number);
+  header.ack_number = htonl(segment->ack_number);
+  header.window = htonl(segment->window);
+  header.ts_val = htonl(segment->ts_val);
+  header.ts_ecr = htonl(segment->ts_ecr);
+  header.checksum = htonl(segment->checksum);
+  header.data_len = htons(segment->data_len);
+  header.head_len = segment->head_len;
+  header.flags = segment->flags;
+  header.num_sack_blocks = segment->num_sack_blocks;
+  header.checksum_type = segment->checksum_type;
+  header.reserved = 0;
+  memcpy(buffer, &header, sizeof(header));
+
+  size_t offset = sizeof(header);
+  for (int i = 0; i < segment->num_sack_blocks; i++) {
+    uint32_t edges[2] = {htonl(segment->sack_blocks[i].start),
+                         htonl(segment->sack_blocks[i].end)};
+    memcpy(buffer + offset, edges, sizeof(edges));
+    offset += sizeof(edges);
+  }
+  return offset;
+}
+
+size_t serialize_tcp_segment(tcp_segment_t *segment, unsigned char *buffer) {
+  size_t offset = serialize_tcp_header(segment, buffer);
+  memcpy(buffer + offset, segment->data, segment->data_len);
+  return offset + segment->data_len;
+}
+
+int deserialize_tcp_segment(unsigned char *buffer, size_t buffer_len,
+                            tcp_segment_t *segment) {
+  tcp_header_t header;
+  if (buffer_len < sizeof(header)) {
+    return 0;
+  }
+  memcpy(&header, buffer, sizeof(header));
+
+  segment->source_port = ntohs(header.source_port);
+  segment->dest_port = ntohs(header.dest_port);
+  segment->seq_number = ntohl(header.seq_number);
+  segment->ack_number = ntohl(header.ack_number);
+  segment->window = ntohl(header.window);
+  segment->ts_val = ntohl(header.ts_val);
+  segment->ts_ecr = ntohl(header.ts_ecr);
+  segment->checksum = ntohl(header.checksum);
+  segment->data_len = ntohs(header.data_len);
+  segment->head_len = header.head_len;
+  segment->flags = header.flags;
+  segment->num_sack_blocks = header.num_sack_blocks;
+  segment->checksum_type = header.checksum_type;
+
+  // the lengths in the header must describe exactly the received bytes
+  if (segment->num_sack_blocks > MAX_SACK_BLOCKS ||
+      segment->checksum_type > CHECKSUM_CRC32C ||
+      segment->data_len > MAX_SEGMENT_DATA_SIZE ||
+      segment->head_len != tcp_header_length(segment) ||
+      segment->head_len + segment->data_len != buffer_len) {
+    return 0;
+  }
+
+  size_t offset = sizeof(header);
+  for (int i = 0; i < segment->num_sack_blocks; i++) {
+    uint32_t edges[2];
+    memcpy(edges, buffer + offset, sizeof(edges));
+    segment->sack_blocks[i].start = ntohl(edges[0]);
+    segment->sack_blocks[i].end = ntohl(edges[1]);
+    offset += sizeof(edges);
+  }
+
+  memcpy(segment->data, buffer + offset, segment->data_len);
+  return 1;
+}
+
+size_t write_syn_options(syn_options_t *options, unsigned char *data) {
+  uint16_t segment_size = htons(options->segment_size);
+  memcpy(data, &segment_size, sizeof(segment_size));
+  data[2] = options->checksum_type;
+  data[3] = 0;
+  size_t len = SYN_OPTIONS_SIZE;
+
+  if (options->num_streams > 1) {
+    uint32_t transfer_id = htonl(options->transfer_id);
+    uint16_t num_streams = htons(options->num_streams);
+    uint64_t offset = htobe64(options->offset);
+    uint64_t total_bytes = htobe64(options->total_bytes);
+    memcpy(data + 4, &transfer_id, sizeof(transfer_id));
+    memcpy(data + 8, &num_streams, sizeof(num_streams));
+    memset(data + 10, 0, 2);
+    memcpy(data + 12, &offset, sizeof(offset));
+    memcpy(data + 20, &total_bytes, sizeof(total_bytes));
+    data[3] |= SYN_OPTION_STRIPED;
+    len = STRIPED_SYN_OPTIONS_SIZE;
+  }
+
+  if (options->fast_open) {
+    uint64_t cookie = htobe64(options->cookie);
+    memcpy(data + len, &cookie, sizeof(cookie));
+    data[3] |= SYN_OPTION_COOKIE;
+    len += sizeof(cookie);
+  }
+  return len;
+}
+
+int read_syn_options(tcp_segment_t *segment, syn_options_t *options) {
+  uint16_t segment_size;
+  if (segment->data_len < sizeof(segment_size)) {
+    return 0;
+  }
+  memcpy(&segment_size, segment->data, sizeof(segment_size));
+  options->segment_size = ntohs(segment_size);
+  if (segment->data_len < SYN_OPTIONS_SIZE) {
+    return 1;
+  }
+  options->checksum_type = segment->data[2];
+  uint8_t flags = segment->data[3];
+  size_t len = SYN_OPTIONS_SIZE;
+
+  if (flags & SYN_OPTION_STRIPED) {
+    if (segment->data_len < STRIPED_SYN_OPTIONS_SIZE) {
+      return 1;
+    }
+    uint32_t transfer_id;
+    uint16_t num_streams;
+    uint64_t offset;
+    uint64_t total_bytes;
+    memcpy(&transfer_id, segment->data + 4, sizeof(transfer_id));
+    memcpy(&num_streams, segment->data + 8, sizeof(num_streams));
+    memcpy(&offset, segment->data + 12, sizeof(offset));
+    memcpy(&total_bytes, segment->data + 20, sizeof(total_bytes));
+    options->transfer_id = ntohl(transfer_id);
+    options->num_streams = ntohs(num_streams);
+    options->offset = be64toh(offset);
+    options->total_bytes = be64toh(total_bytes);
+    len = STRIPED_SYN_OPTIONS_SIZE;
+  }
+
+  uint64_t cookie;
+  if ((flags & SYN_OPTION_COOKIE) &&
+      segment->data_len >= len + sizeof(cookie)) {
+    memcpy(&cookie, segment->data + len, sizeof(cookie));
+    options->fast_open = 1;
+    options->cookie = be64toh(cookie);
+  }
+  return 1;
+}
+
+size_t write_fin_digest(uint64_t digest, unsigned char *data) {
+  uint64_t digest_be = htobe64(digest);
+  memcpy(data, &digest_be, sizeof(digest_be));
+  return FIN_DIGEST_SIZE;
+}
+
+int read_fin_digest(tcp_segment_t *segment, uint64_t *digest) {
+  // senders without a digest close with a text payload of another length
+  if (segment->data_len != FIN_DIGEST_SIZE) {
+    return 0;
+  }
+  uint64_t digest_be;
+  memcpy(&digest_be, segment->data, sizeof(digest_be));
+  *digest = be64toh(digest_be);
+  return 1;
+}
+
+int read_rst_reason(tcp_segment_t *segment) {
+  return segment->data_len == 1 ? (unsigned char)segment->data[0] : 0;
+}
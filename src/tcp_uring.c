@@ -0,0 +1,157 @@
+/**
+ * @file tcp_uring.c
+ * @brief Function definitions for driving an io_uring instance
+ *
+ * This file contains the function definitions for setting up an io_uring
+ * submission and completion queue pair with the raw system calls, preparing
+ * submission queue entries, submitting them and waiting for their completions
+ * with a single system call, and reading the completions back.
+ *
+ * @author Ritam Singal (ritamsingal)
+ * @author Harshil Patel (harshil-patel11)
+ * @bug No known bugs
+ */
+
+#define _GNU_SOURCE
+
+#include <errno.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <sys/uio.h>
+#include <unistd.h>
+
+#include "../include/tcp_uring.h"
+
+int init_tcp_uring(tcp_uring_t *ring, unsigned entries) {
+  memset(ring, 0, sizeof(*ring));
+  ring->ring_fd = -1;
+
+  // completions are only needed when the one thread that submits waits for
+  // them, which spares the kernel from interrupting it; older kernels lack
+  // these flags
+  struct io_uring_params params;
+  memset(&params, 0, sizeof(params));
+  params.flags = IORING_SETUP_SINGLE_ISSUER | IORING_SETUP_DEFER_TASKRUN;
+  int ring_fd = syscall(__NR_io_uring_setup, entries, &params);
+  if (ring_fd < 0) {
+    memset(&params, 0, sizeof(params));
+    ring_fd = syscall(__NR_io_uring_setup, entries, &params);
+  }
+  if (ring_fd < 0) {
+    return -1;
+  }
+  ring->ring_fd = ring_fd;
+
+  ring->sq_ring_size =
+      params.sq_off.array + params.sq_entries * sizeof(unsigned);
+  ring->cq_ring_size =
+      params.cq_off.cqes + params.cq_entries * sizeof(struct io_uring_cqe);
+  ring->sqes_size = params.sq_entries * sizeof(struct io_uring_sqe);
+  ring->sq_ring = mmap(NULL, ring->sq_ring_size, PROT_READ | PROT_WRITE,
+                       MAP_SHARED | MAP_POPULATE, ring_fd, IORING_OFF_SQ_RING);
+  ring->cq_ring = mmap(NULL, ring->cq_ring_size, PROT_READ | PROT_WRITE,
+                       MAP_SHARED | MAP_POPULATE, ring_fd, IORING_OFF_CQ_RING);
+  ring->sqes = mmap(NULL, ring->sqes_size, PROT_READ | PROT_WRITE,
+                    MAP_SHARED | MAP_POPULATE, ring_fd, IORING_OFF_SQES);
+  if (ring->sq_ring == MAP_FAILED || ring->cq_ring == MAP_FAILED ||
+      ring->sqes == MAP_FAILED) {
+    free_tcp_uring(ring);
+    return -1;
+  }
+
+  char *sq = ring->sq_ring;
+  char *cq = ring->cq_ring;
+  ring->sq_head = (unsigned *)(sq + params.sq_off.head);
+  ring->sq_tail = (unsigned *)(sq + params.sq_off.tail);
+  ring->sq_mask = (unsigned *)(sq + params.sq_off.ring_mask);
+  ring->sq_array = (unsigned *)(sq + params.sq_off.array);
+  ring->cq_head = (unsigned *)(cq + params.cq_off.head);
+  ring->cq_tail = (unsigned *)(cq + params.cq_off.tail);
+  ring->cq_mask = (unsigned *)(cq + params.cq_off.ring_mask);
+  ring->cqes = (struct io_uring_cqe *)(cq + params.cq_off.cqes);
+  ring->sq_entries = params.sq_entries;
+  return 0;
+}
+
+void free_tcp_uring(tcp_uring_t *ring) {
+  if (ring->sq_ring != NULL && ring->sq_ring != MAP_FAILED) {
+    munmap(ring->sq_ring, ring->sq_ring_size);
+  }
+  if (ring->cq_ring != NULL && ring->cq_ring != MAP_FAILED) {
+    munmap(ring->cq_ring, ring->cq_ring_size);
+  }
+  if (ring->sqes != NULL && ring->sqes != MAP_FAILED) {
+    munmap(ring->sqes, ring->sqes_size);
+  }
+  if (ring->ring_fd >= 0) {
+    close(ring->ring_fd);
+  }
+  ring->sq_ring = NULL;
+  ring->cq_ring = NULL;
+  ring->sqes = NULL;
+  ring->ring_fd = -1;
+}
+
+int register_uring_buffer(tcp_uring_t *ring, void *buffer, size_t length) {
+  struct iovec iov = {.iov_base = buffer, .iov_len = length};
+  return syscall(__NR_io_uring_register, ring->ring_fd,
+                 IORING_REGISTER_BUFFERS, &iov, 1) < 0
+             ? -1
+             : 0;
+}
+
+struct io_uring_sqe *get_uring_sqe(tcp_uring_t *ring) {
+  // only this thread moves the tail, the kernel moves the head
+  unsigned head = __atomic_load_n(ring->sq_head, __ATOMIC_ACQUIRE);
+  unsigned tail = *ring->sq_tail + ring->num_prepared;
+  if (tail - head >= ring->sq_entries) {
+    return NULL;
+  }
+
+  unsigned index = tail & *ring->sq_mask;
+  struct io_uring_sqe *sqe = &ring->sqes[index];
+  memset(sqe, 0, sizeof(*sqe));
+  ring->sq_array[index] = index;
+  ring->num_prepared++;
+  return sqe;
+}
+
+struct io_uring_sqe *acquire_uring_sqe(tcp_uring_t *ring) {
+  struct io_uring_sqe *sqe = get_uring_sqe(ring);
+  // the kernel takes submitted entries off the queue right away
+  if (sqe == NULL && submit_uring(ring, 0) >= 0) {
+    sqe = get_uring_sqe(ring);
+  }
+  return sqe;
+}
+
+int submit_uring(tcp_uring_t *ring, unsigned wait_nr) {
+  unsigned num_submitted = ring->num_prepared;
+  unsigned to_submit = num_submitted;
+  __atomic_store_n(ring->sq_tail, *ring->sq_tail + to_submit,
+                   __ATOMIC_RELEASE);
+  ring->num_prepared = 0;
+
+  unsigned flags = wait_nr > 0 ? IORING_ENTER_GETEVENTS : 0;
+  int retval;
+  do {
+    retval = syscall(__NR_io_uring_enter, ring->ring_fd, to_submit, wait_nr,
+                     flags, NULL, 0);
+    // entries are consumed even if the wait is interrupted
+    if (retval < 0 && errno == EINTR) {
+      to_submit = 0;
+    }
+  } while (retval < 0 && errno == EINTR);
+  return retval < 0 ? -1 : (int)num_submitted;
+}
+
+int next_uring_cqe(tcp_uring_t *ring, struct io_uring_cqe *cqe) {
+  unsigned head = *ring->cq_head;
+  if (head == __atomic_load_n(ring->cq_tail, __ATOMIC_ACQUIRE)) {
+    return 0;
+  }
+  *cqe = ring->cqes[head & *ring->cq_mask];
+  __atomic_store_n(ring->cq_head, head + 1, __ATOMIC_RELEASE);
+  return 1;
+}
@@ -11,14 +11,20 @@
  */
 
 #include <arpa/inet.h>
+#include <limits.h>
 #include <netdb.h>
 #include <netinet/in.h>
+#include <poll.h>
 #include <stdio.h>
+#include <string.h>
 #include <sys/socket.h>
 #include <sys/time.h>
+#include <time.h>
+#include <unistd.h>
 
 #include "../include/tcp_segment.h"
 #include "../include/tcp_utils.h"
+#include "../include/utils.h"
 
 int create_socket() {
   int socket_desc;
@@ -26,6 +32,27 @@ int create_socket() {
   return socket_desc;
 }
 
+void set_socket_buffers(int socket_desc, size_t num_bytes) {
+  int size = (int)MIN(num_bytes, (size_t)INT_MAX);
+  // as root the limits in net.core.[rw]mem_max can be bypassed
+  if (setsockopt(socket_desc, SOL_SOCKET, SO_RCVBUFFORCE, &size,
+                 sizeof(size)) < 0) {
+    setsockopt(socket_desc, SOL_SOCKET, SO_RCVBUF, &size, sizeof(size));
+  }
+  if (setsockopt(socket_desc, SOL_SOCKET, SO_SNDBUFFORCE, &size,
+                 sizeof(size)) < 0) {
+    setsockopt(socket_desc, SOL_SOCKET, SO_SNDBUF, &size, sizeof(size));
+  }
+}
+
+int set_socket_reuse_port(int socket_desc) {
+  int enable = 1;
+  return setsockopt(socket_desc, SOL_SOCKET, SO_REUSEPORT, &enable,
+                    sizeof(enable)) < 0
+             ? -1
+             : 0;
+}
+
 int bind_socket(int socket_desc, struct sockaddr_in *server_addr,
                 unsigned short int udp_port, char *ip_addr) {
   server_addr->sin_family = AF_INET;
@@ -80,11 +107,62 @@ int get_host_ip_by_hostname(char **ip, char *host) {
   return 0;
 }
 
+int probe_segment_size(struct sockaddr_in *addr) {
+  int socket_desc = create_socket();
+  if (socket_desc < 0) {
+    return -1;
+  }
+
+  // the path MTU is only tracked for connected sockets that forbid
+  // fragmentation
+  int discover = IP_PMTUDISC_DO;
+  int mtu;
+  socklen_t mtu_len = sizeof(mtu);
+  if (setsockopt(socket_desc, IPPROTO_IP, IP_MTU_DISCOVER, &discover,
+                 sizeof(discover)) < 0 ||
+      connect(socket_desc, (struct sockaddr *)addr, sizeof(*addr)) < 0 ||
+      getsockopt(socket_desc, IPPROTO_IP, IP_MTU, &mtu, &mtu_len) < 0) {
+    close(socket_desc);
+    return -1;
+  }
+  close(socket_desc);
+
+  // an IPv4 header without options and a UDP header precede the segment
+  return mtu - 20 - 8 - (int)sizeof(tcp_header_t);
+}
+
+size_t encode_tcp(tcp_segment_t *send_segment, unsigned char *buffer) {
+  size_t offset = encode_tcp_header(send_segment, send_segment->data, buffer);
+  memcpy(buffer + offset, send_segment->data, send_segment->data_len);
+  return offset + send_segment->data_len;
+}
+
+size_t encode_tcp_header(tcp_segment_t *send_segment, const char *payload,
+                         unsigned char *buffer) {
+  send_segment->ts_val = (uint32_t)get_time_us();
+  send_segment->head_len = tcp_header_length(send_segment);
+  send_segment->checksum = calculate_payload_checksum(send_segment, payload);
+  return serialize_tcp_header(send_segment, buffer);
+}
+
+tcp_error_t decode_tcp(unsigned char *buffer, size_t length,
+                       tcp_segment_t *recv_segment) {
+  if (deserialize_tcp_segment(buffer, length, recv_segment) == 0) {
+    return MALFORMED_SEGMENT;
+  }
+  if (compare_checksum(recv_segment) == 0) {
+    return CHECKSUM_FAILED;
+  }
+  return SUCCESS;
+}
+
 tcp_error_t send_tcp(int socket_desc, tcp_segment_t *send_segment,
                      struct sockaddr_in *server_addr) {
 
-  if (sendto(socket_desc, send_segment, sizeof(*send_segment), 0,
-             (struct sockaddr *)server_addr, sizeof(*server_addr)) < 0) {
+  unsigned char buffer[MAX_WIRE_SEGMENT_SIZE];
+  size_t length = encode_tcp(send_segment, buffer);
+  if (sendto(socket_desc, buffer, length, 0, (struct sockaddr *)server_addr,
+             sizeof(*server_addr)) < 0) {
     return SEND_FAILED;
   }
   return SUCCESS;
@@ -93,31 +171,27 @@ tcp_error_t send_tcp(int socket_desc, tcp_segment_t *send_segment,
 tcp_error_t recv_tcp(int socket_desc, struct sockaddr_in *client_addr,
                      tcp_segment_t *recv_segment) {
   size_t client_addr_len = sizeof(*client_addr);
-  if (recvfrom(socket_desc, recv_segment, sizeof(*recv_segment), 0,
-               (struct sockaddr *)client_addr, &client_addr_len) < 0) {
+  unsigned char buffer[MAX_WIRE_SEGMENT_SIZE];
+  ssize_t length = recvfrom(socket_desc, buffer, sizeof(buffer), 0,
+                            (struct sockaddr *)client_addr, &client_addr_len);
+  if (length < 0) {
     return RECV_FAILED;
   }
-  if (compare_checksum(recv_segment) == 0) {
-    return CHECKSUM_FAILED;
-  }
-  return SUCCESS;
+  return decode_tcp(buffer, length, recv_segment);
 }
 
 tcp_error_t recv_tcp_with_timeout(int socket_desc,
                                   struct sockaddr_in *client_addr,
-                                  tcp_segment_t *recv_segment) {
+                                  tcp_segment_t *recv_segment,
+                                  long timeout_us) {
 
   int recv_retval = 0;
 
-  fd_set fds;
-  FD_ZERO(&fds);
-  FD_SET(socket_desc, &fds);
-
-  struct timeval timeout;
-  timeout.tv_sec = 0;                   // Timeout in seconds
-  timeout.tv_usec = DEFAULT_TIMEOUT_US; // Timeout in microseconds
+  // poll has no FD_SETSIZE limit on the descriptor
+  struct pollfd fds = {.fd = socket_desc, .events = POLLIN};
+  int timeout_ms = (timeout_us + 999) / 1000; // Timeout rounded up to ms
 
-  int activity = select(socket_desc + 1, &fds, NULL, NULL, &timeout);
+  int activity = poll(&fds, 1, timeout_ms);
   if (activity == -1) {
     return UNKNOWN_FAILURE;
   } else if (activity == 0) {
@@ -127,4 +201,10 @@ tcp_error_t recv_tcp_with_timeout(int socket_desc,
   }
 
   return recv_retval;
+}
+
+uint64_t get_time_us() {
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return (uint64_t)now.tv_sec * 1000000 + now.tv_nsec / 1000;
 }
\ No newline at end of file
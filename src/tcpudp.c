@@ -0,0 +1,397 @@
+/**
+ * @file tcpudp.c
+ *
+ * @brief Function definitions for the connections of libtcpudp
+ *
+ * This file contains the function definitions for opening, using and closing
+ * connections that carry a byte stream. The sending end drives the same
+ * sender as rsend(), with a send buffer the application appends to instead of
+ * a file. The receiving end is a connection of a receiver in stream mode,
+ * whose buffer holds the payloads until the application reads them.
+ *
+ * @author Ritam Singal (ritamsingal)
+ * @author Harshil Patel (harshil-patel11)
+ * @bug No known bugs
+ */
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <sys/socket.h>
+#include <sys/types.h>
+#include <unistd.h>
+
+#include "../include/fast_open.h"
+#include "../include/tcpudp.h"
+#include "../include/utils.h"
+
+tcpudp_conn_t *tcpudp_connect(char *hostname, unsigned short int port,
+                              sender_options_t *options) {
+  char *server_ip;
+  if (get_host_ip_by_hostname(&server_ip, hostname) < 0) {
+    printf("Couldn't get server IP\n");
+    return NULL;
+  }
+
+  tcpudp_conn_t *conn = calloc(1, sizeof(tcpudp_conn_t));
+  if (conn == NULL) {
+    printf("Couldn't allocate connection\n");
+    return NULL;
+  }
+  conn->server_addr.sin_family = AF_INET;
+  conn->server_addr.sin_port = htons(port);
+  conn->server_addr.sin_addr.s_addr = inet_addr(server_ip);
+
+  int socket_desc = create_socket();
+  if (socket_desc < 0) {
+    printf("Error while creating socket\n");
+    free(conn);
+    return NULL;
+  }
+
+  socklen_t client_addr_len = sizeof(conn->client_addr);
+  if (getsockname(socket_desc, (struct sockaddr *)&conn->client_addr,
+                  &client_addr_len) < 0) {
+    printf("Couldn't get socket name\n");
+    close(socket_desc);
+    free(conn);
+    return NULL;
+  }
+  in_port_t client_port = ntohs(conn->client_addr.sin_port);
+
+  syn_options_t syn_options = {.segment_size = options->segment_size,
+                               .checksum_type = options->checksum_type};
+  if (options->probe_path_mtu) {
+    int path_segment_size = probe_segment_size(&conn->server_addr);
+    if (path_segment_size > 0) {
+      syn_options.segment_size =
+          MAX(MIN(path_segment_size, MAX_SEGMENT_DATA_SIZE),
+              MIN_SEGMENT_DATA_SIZE);
+    }
+  }
+
+  init_rtt_estimator(&conn->rtt);
+
+  uint32_t receive_window;
+  uint32_t receiver_isn;
+  if (establish_connection_sender(client_port, port, socket_desc,
+                                  &conn->server_addr, &conn->client_addr,
+                                  &conn->rtt, &receive_window,
+                                  &receiver_isn, &syn_options,
+                                  NULL) != SUCCESS) {
+    printf("Couldn't establish connection\n");
+    close(socket_desc);
+    free(conn);
+    return NULL;
+  }
+  uint16_t segment_size = syn_options.segment_size;
+
+  // the socket has to absorb bursts as large as the window
+  set_socket_buffers(socket_desc, options->max_window *
+                                      (sizeof(tcp_header_t) + segment_size));
+
+  init_congestion_control(&conn->cc, options->cc_algorithm,
+                          options->max_window);
+
+  // like the buffer of a file, the stream buffer holds two windows, so the
+  // application can append while a full window is in flight
+  if (init_send_window(&conn->window, options->max_window) < 0 ||
+      init_stream_buffer(&conn->buffer, 2 * options->max_window,
+                         segment_size) < 0 ||
+      init_tcp_io(&conn->io, socket_desc, IO_BATCH_SIZE, options->offload,
+                  options->io_engine) < 0) {
+    printf("Couldn't allocate send window\n");
+    free_send_buffer(&conn->buffer);
+    free_send_window(&conn->window);
+    close(socket_desc);
+    free(conn);
+    return NULL;
+  }
+  conn->window.io = &conn->io;
+  conn->window.retransmit_mode = options->retransmit_mode;
+  conn->window.checksum_type = syn_options.checksum_type;
+  conn->window.rtt = &conn->rtt;
+  conn->window.cc = &conn->cc;
+  conn->window.receive_window_end = receive_window;
+  conn->window.receiver_isn = receiver_isn;
+  conn->window.max_rate =
+      (double)options->max_rate / (sizeof(tcp_header_t) + segment_size);
+
+  conn->sender = (sender_state_t){.socket_desc = socket_desc,
+                                  .host_udp_port = port,
+                                  .client_port = client_port,
+                                  .server_addr = &conn->server_addr,
+                                  .file = NULL,
+                                  .bytes_left = 0,
+                                  .window = &conn->window,
+                                  .buffer = &conn->buffer};
+  if (init_event_loop(&conn->loop) < 0) {
+    printf("Couldn't create event loop\n");
+    free_tcp_io(&conn->io);
+    free_send_buffer(&conn->buffer);
+    free_send_window(&conn->window);
+    close(socket_desc);
+    free(conn);
+    return NULL;
+  }
+  if (add_event_source(&conn->loop, &conn->sender.socket_source, socket_desc,
+                       EPOLLIN, handle_sender_socket, &conn->sender) < 0 ||
+      init_event_timer(&conn->loop, &conn->sender.retransmit_timer,
+                       handle_retransmit_timer, &conn->sender) < 0) {
+    printf("Couldn't create event loop\n");
+    free_event_loop(&conn->loop);
+    free_tcp_io(&conn->io);
+    free_send_buffer(&conn->buffer);
+    free_send_window(&conn->window);
+    close(socket_desc);
+    free(conn);
+    return NULL;
+  }
+
+  conn->error = SUCCESS;
+  return conn;
+}
+
+tcpudp_listener_t *tcpudp_listen(unsigned short int port,
+                                 receiver_options_t *options) {
+  char *ip;
+  if (get_host_ip(&ip) < 0) {
+    printf("Error while getting host IP\n");
+    return NULL;
+  }
+
+  tcpudp_listener_t *listener = calloc(1, sizeof(tcpudp_listener_t));
+  if (listener == NULL) {
+    printf("Couldn't allocate listener\n");
+    return NULL;
+  }
+
+  // each connection is its own stream, accepted one at a time
+  listener->options = *options;
+  listener->options.server = 1;
+  listener->options.stream = 1;
+  listener->options.num_workers = 1;
+  if (listener->options.cookie_key_file != NULL &&
+      load_fast_open_key(listener->options.cookie_key_file,
+                         listener->options.cookie_key) < 0) {
+    printf("Couldn't load the fast open key\n");
+    free(listener);
+    return NULL;
+  }
+
+  receiver_state_t *state = &listener->state;
+  state->options = &listener->options;
+  state->port = port;
+  state->ip = ip;
+  state->max_connections = listener->options.max_connections;
+  if (start_receiver(state, &listener->loop) < 0) {
+    free(listener);
+    return NULL;
+  }
+  return listener;
+}
+
+tcpudp_conn_t *tcpudp_accept(tcpudp_listener_t *listener) {
+  receiver_state_t *state = &listener->state;
+  if (poll_event_loop(&listener->loop, 0) != EVENT_CONTINUE ||
+      state->accept_head == NULL) {
+    return NULL;
+  }
+
+  tcpudp_conn_t *conn = calloc(1, sizeof(tcpudp_conn_t));
+  if (conn == NULL) {
+    printf("Couldn't allocate connection\n");
+    return NULL;
+  }
+
+  connection_t *connection = state->accept_head;
+  state->accept_head = connection->next_accept;
+  if (state->accept_head == NULL) {
+    state->accept_tail = NULL;
+  }
+  connection->next_accept = NULL;
+
+  conn->connection = connection;
+  conn->listener = listener;
+  conn->error = SUCCESS;
+  return conn;
+}
+
+ssize_t tcpudp_send(tcpudp_conn_t *conn, const void *data, size_t len) {
+  if (conn->connection != NULL) {
+    return UNKNOWN_FAILURE;
+  }
+  int retval = tcpudp_process(conn);
+  if (retval != SUCCESS) {
+    return retval;
+  }
+
+  size_t num_appended =
+      append_send_buffer(&conn->buffer, conn->window.base, data, len);
+  if (num_appended == 0 && len > 0) {
+    return WOULD_BLOCK;
+  }
+  conn->bytes_sent += num_appended;
+
+  retval = advance_sender(&conn->sender);
+  if (retval != EVENT_CONTINUE) {
+    conn->error = retval;
+    return retval;
+  }
+  return num_appended;
+}
+
+int tcpudp_flush(tcpudp_conn_t *conn) {
+  if (conn->connection != NULL) {
+    return UNKNOWN_FAILURE;
+  }
+  if (conn->error != SUCCESS) {
+    return conn->error;
+  }
+
+  seal_send_buffer(&conn->buffer);
+  int retval = advance_sender(&conn->sender);
+  if (retval != EVENT_CONTINUE) {
+    conn->error = retval;
+    return retval;
+  }
+  return SUCCESS;
+}
+
+ssize_t tcpudp_recv(tcpudp_conn_t *conn, void *data, size_t len) {
+  if (conn->connection == NULL) {
+    return UNKNOWN_FAILURE;
+  }
+  int retval = tcpudp_process(conn);
+  if (retval != SUCCESS) {
+    return retval;
+  }
+
+  // a failed connection may hold bytes, but none of them can be trusted
+  connection_t *connection = conn->connection;
+  if (connection->error != SUCCESS) {
+    return connection->error;
+  }
+
+  receive_buffer_t *buffer = &connection->file_buffer;
+  uint32_t window = advertised_window(buffer);
+  size_t num_read = read_receive_buffer(buffer, data, len);
+  conn->bytes_received += num_read;
+
+  // a sender stopped by a full buffer only learns that it was read from an
+  // ACK, which is sent once rather than for every read
+  uint32_t half = buffer->num_segments / 2;
+  if (!connection->closed && window < half &&
+      advertised_window(buffer) >= half) {
+    tcp_error_t ack_retval =
+        send_ack(conn->listener->state.socket_desc, &connection->addr, buffer,
+                 connection->ts_recent);
+    if (ack_retval != SUCCESS) {
+      conn->error = ack_retval;
+      return ack_retval;
+    }
+  }
+
+  if (num_read > 0 || len == 0) {
+    return num_read;
+  }
+  return connection->closed ? 0 : WOULD_BLOCK;
+}
+
+int tcpudp_process(tcpudp_conn_t *conn) {
+  if (conn->error != SUCCESS) {
+    return conn->error;
+  }
+
+  // the receiving end shares the loop of its listener
+  event_loop_t *loop =
+      conn->connection != NULL ? &conn->listener->loop : &conn->loop;
+  int retval = poll_event_loop(loop, 0);
+  if (retval != EVENT_CONTINUE) {
+    conn->error = retval;
+    return retval;
+  }
+  return SUCCESS;
+}
+
+int tcpudp_fileno(tcpudp_conn_t *conn) {
+  if (conn->connection != NULL) {
+    return conn->listener->loop.epoll_fd;
+  }
+  return conn->loop.epoll_fd;
+}
+
+int tcpudp_listener_fileno(tcpudp_listener_t *listener) {
+  return listener->loop.epoll_fd;
+}
+
+void tcpudp_get_stats(tcpudp_conn_t *conn, tcpudp_stats_t *stats) {
+  memset(stats, 0, sizeof(*stats));
+  stats->bytes_sent = conn->bytes_sent;
+  stats->bytes_received = conn->bytes_received;
+  if (conn->connection != NULL) {
+    stats->receive_window = advertised_window(&conn->connection->file_buffer);
+    return;
+  }
+
+  // every segment below next was sent once, the other sends were repeats
+  send_window_t *window = &conn->window;
+  stats->segments_sent = window->num_sent;
+  stats->segments_retransmitted = window->num_sent - window->next;
+  stats->srtt_us = conn->rtt.srtt_us;
+  stats->rto_us = conn->rtt.rto_us;
+  stats->congestion_window = cc_window(&conn->cc);
+  stats->pacing_rate = sender_pacing_rate(window) *
+                       (sizeof(tcp_header_t) + conn->buffer.segment_size);
+  stats->receive_window = window->receive_window_end - window->base;
+}
+
+int tcpudp_close(tcpudp_conn_t *conn) {
+  if (conn->connection != NULL) {
+    connection_t *connection = conn->connection;
+    receiver_state_t *state = &conn->listener->state;
+    // a sender still sending has to learn that nobody reads its bytes
+    if (!connection->closed) {
+      reset_connection_receiver(state->socket_desc, &connection->addr,
+                                connection->ts_recent, RST_REASON_CLOSED);
+    }
+    free_connection(state, connection);
+    free(conn);
+    return SUCCESS;
+  }
+
+  // the last segment goes out even if it is not full, then the FIN follows
+  // once every segment was acknowledged
+  int retval = conn->error;
+  if (retval == SUCCESS) {
+    seal_send_buffer(&conn->buffer);
+    conn->buffer.eof = 1;
+    retval = advance_sender(&conn->sender);
+    if (retval == EVENT_CONTINUE) {
+      retval = run_event_loop(&conn->loop);
+    }
+  }
+  free_event_timer(&conn->loop, &conn->sender.retransmit_timer);
+  free_event_loop(&conn->loop);
+  if (retval == EVENT_STOP) {
+    retval = close_connection_sender(
+        conn->sender.client_port, conn->sender.host_udp_port,
+        conn->sender.socket_desc, &conn->server_addr, &conn->client_addr,
+        &conn->rtt, conn->window.next, xxh64_digest(&conn->window.digest));
+  }
+
+  free_tcp_io(&conn->io);
+  free_send_buffer(&conn->buffer);
+  free_send_window(&conn->window);
+  close(conn->sender.socket_desc);
+  free(conn);
+  return retval;
+}
+
+void tcpudp_close_listener(tcpudp_listener_t *listener) {
+  stop_receiver(&listener->state);
+  free(listener);
+}